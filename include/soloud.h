@@ -28,6 +28,8 @@ freely, subject to the following restrictions:
 #include <math.h>    // sin
 #include <stdlib.h>  // rand
 
+#include <atomic>  // std::atomic
+
 #ifdef SOLOUD_NO_ASSERTS
 #define SOLOUD_ASSERT(x)
 #else
@@ -89,14 +91,43 @@ freely, subject to the following restrictions:
 // Maximum number of filters per stream
 #define FILTERS_PER_STREAM 8
 
+// Maximum number of aux sends per voice
+#define SENDS_PER_VOICE 4
+
 // Number of samples to process on one go
 #define SAMPLE_GRANULARITY 512
 
-// Maximum number of concurrent voices (hard limit is 4095)
+// Maximum number of concurrent voices (hard limit is 65535)
+#ifndef VOICE_COUNT
 #define VOICE_COUNT 1024
+#endif
+
+// Voice handles keep the voice slot + 1 in the low 16 bits and the slot's
+// generation in the high 16 bits. Generation 0xffff is never handed out, so a
+// voice handle can't collide with a voice group handle (0xfffff000 | group).
+#define SOLOUD_HANDLE_SLOT_MASK 0xffff
+#define SOLOUD_HANDLE_GENERATION_SHIFT 16
 
-// 1)mono, 2)stereo 4)quad 6)5.1 8)7.1
+// Virtual voice handles keep the voice index + 1 in the low 24 bits and the
+// index's generation in the high 8 bits. They are a namespace of their own,
+// only understood by the virtual voice functions.
+#define SOLOUD_VIRTUAL_INDEX_MASK 0xffffff
+#define SOLOUD_VIRTUAL_GENERATION_SHIFT 24
+
+// Default number of real voices the virtual voices may occupy
+#define SOLOUD_DEFAULT_VIRTUAL_VOICE_LIMIT 32
+
+// 1)mono, 2)stereo 4)quad 6)5.1 8)7.1. Can be raised (e.g. to 16 or 32) for
+// larger speaker arrays, which use a generic channel mapping.
+#ifndef MAX_CHANNELS
 #define MAX_CHANNELS 8
+#endif
+
+// Peak level below which output is considered silent
+#define SOLOUD_SILENCE_THRESHOLD (1.0f / 65536.0f)
+
+// Seconds global filters must stay silent before the mixer goes idle
+#define SOLOUD_IDLE_FILTER_TAIL 1.0f
 
 // Default resampler for both main and bus mixers
 #define SOLOUD_DEFAULT_RESAMPLER SoLoud::Soloud::RESAMPLER_LINEAR
@@ -117,6 +148,12 @@ typedef unsigned int handle;
 typedef double time;
 };  // namespace SoLoud
 
+namespace SoLoud {
+namespace Thread {
+class Pool;
+}
+};  // namespace SoLoud
+
 namespace SoLoud {
 // Class that handles aligned allocations to support vectorized operations
 class AlignedFloatBuffer {
@@ -156,6 +193,86 @@ class TinyAlignedFloatBuffer {
 
 namespace SoLoud {
 
+// Copy of a voice's queryable state. The mixer (and any call that changes the
+// voice) republishes it under a sequence lock, so getters can read it without
+// taking the audio mutex. mSequence is odd while an update is in progress.
+struct VoiceSnapshot {
+  std::atomic<unsigned int> mSequence;
+  // Handle of the voice in this slot, 0 if the slot is empty
+  std::atomic<handle> mHandle;
+  // AudioSourceInstance::FLAGS
+  std::atomic<unsigned int> mFlags;
+  std::atomic<unsigned int> mLoopCount;
+  std::atomic<float> mVolume;
+  std::atomic<float> mOverallVolume;
+  std::atomic<float> mPan;
+  std::atomic<float> mRelativePlaySpeed;
+  std::atomic<float> mSamplerate;
+  std::atomic<time> mStreamTime;
+  std::atomic<time> mStreamPosition;
+  std::atomic<time> mLoopPoint;
+};
+
+// Links a voice slot into the list of live voices of its audio source.
+struct VoiceSourceLink {
+  // Source the voice was started from, NULL for an empty slot
+  AudioSource* mSource;
+  // Neighbouring slots in the source's list, -1 at the ends
+  int mPrev;
+  int mNext;
+  // In the source's list; false if another engine held it at play time
+  bool mListed;
+};
+
+// Membership of one voice in one voice group. A group's members form a
+// doubly linked list; each voice also chains its own memberships so stopping
+// it can leave every group it's in.
+struct VoiceGroupMember {
+  // Member voice slot, -1 once the node has been released
+  int mVoice;
+  // Group the node belongs to
+  unsigned int mGroup;
+  // Neighbours in the group's member list, -1 at the ends. A released node
+  // keeps mNext so a FOR_ALL_VOICES walk that is standing on it can go on.
+  int mPrev;
+  int mNext;
+  // Next membership of the same voice, or next node on the free list
+  int mVoiceNext;
+};
+
+// Voice group slot
+struct VoiceGroup {
+  // First and last member nodes (in the order they were added), -1 if the
+  // group is empty
+  int mFirstMember;
+  int mLastMember;
+  // Slot holds a live group
+  bool mInUse;
+};
+
+// Lightweight emitter tracked without an audio source instance. While
+// mVoice is 0 it only advances its playhead in time; once it ranks among the
+// most audible it is given a real 3d voice seeked to the playhead.
+struct VirtualVoice {
+  // Source to play, NULL for a free entry
+  AudioSource* mSource;
+  float mPosition[3];
+  float mVolume;
+  unsigned int mPriority;
+  unsigned int mBus;
+  // Playhead in seconds as of mPlayheadTime (Soloud stream time)
+  time mPlayhead;
+  time mPlayheadTime;
+  // Real voice handle, 0 while virtual
+  handle mVoice;
+  // Volume after distance attenuation, as of the last update
+  float mAudibility;
+  // Bumped each time the entry is reused
+  unsigned char mGeneration;
+  // Next entry on the free list
+  int mNextFree;
+};
+
 // Soloud core class.
 class Soloud {
  public:
@@ -222,6 +339,28 @@ class Soloud {
 
   enum RESAMPLER { RESAMPLER_POINT, RESAMPLER_LINEAR, RESAMPLER_CATMULLROM };
 
+  // Quality levels of the CPU budget governor. Each level keeps the
+  // reductions of the ones before it.
+  enum GOVERNOR_LEVEL {
+    // Full quality
+    GOVERNOR_FULL = 0,
+    // Unprotected voices resample with at most linear interpolation
+    GOVERNOR_LINEAR_RESAMPLER,
+    // Unprotected voices use point sampling
+    GOVERNOR_POINT_RESAMPLER,
+    // Filters marked optional on their sources are skipped
+    GOVERNOR_SKIP_OPTIONAL_FILTERS,
+    // Busses with a reduced internal samplerate run at half of it
+    GOVERNOR_HALVE_BUS_RATE,
+    // Fewer voices are mixed, see setGovernorVoiceLimit
+    GOVERNOR_LIMIT_VOICES
+  };
+
+  // Called from the audio thread when the governor changes level. aLoad is
+  // the mix time of the buffer that triggered it, relative to its duration.
+  typedef void (*governorCallback)(
+    unsigned int aLevel, float aLoad, void* aUserData);
+
   // Initialize SoLoud. Must be called before SoLoud can be used.
   result init(unsigned int aFlags = Soloud::CLIP_ROUNDOFF,
     unsigned int aBackend = Soloud::AUTO,
@@ -284,6 +423,12 @@ class Soloud {
   // Seek the audio stream to certain point in time. Some streams can't seek
   // backwards. Relative play speed affects time.
   result seek(handle aVoiceHandle, time aSeconds);
+  // Seek on a worker thread instead of under the audio mutex. The voice is
+  // held silent at its old position until the seek lands; seeking it again
+  // meanwhile retargets the seek in flight.
+  result seekAsync(handle aVoiceHandle, time aSeconds);
+  // Is an asynchronous seek still running on this voice?
+  bool isSeeking(handle aVoiceHandle);
   // Stop the sound.
   void stop(handle aVoiceHandle);
   // Stop all voices.
@@ -338,6 +483,17 @@ class Soloud {
   float getGlobalVolume() const;
   // Get current maximum active voice setting
   unsigned int getMaxActiveVoiceCount() const;
+  // Get the current governor level (GOVERNOR_LEVEL)
+  unsigned int getGovernorLevel() const;
+  // Get the time the last mix took relative to the buffer's duration
+  float getMixLoad() const;
+  // Get how many voices the last mix read straight from sample memory,
+  // skipping getAudio and the resampler (see AudioSourceInstance::
+  // getDirectData)
+  unsigned int getDirectVoiceCount() const;
+  // Query whether the last mixed buffer was skipped as silent (nothing playing
+  // and global filter tails decayed). Back-ends may use this to idle.
+  bool isIdle() const;
   // Query whether a voice is set to loop.
   bool getLooping(handle aVoiceHandle);
   // Query whether a voice is set to auto-stop when it ends.
@@ -353,6 +509,17 @@ class Soloud {
   void setAutoStop(handle aVoiceHandle, bool aAutoStop);
   // Set current maximum active voice setting
   result setMaxActiveVoiceCount(unsigned int aVoiceCount);
+  // Enable the CPU budget governor. A mix taking more than aHighLoad of its
+  // buffer's duration steps quality down a level (no further than aMaxLevel);
+  // aHoldBuffers mixes in a row under aLowLoad step it back up.
+  result setGovernor(bool aEnable, float aHighLoad = 0.8f,
+    float aLowLoad = 0.5f, unsigned int aHoldBuffers = 50,
+    unsigned int aMaxLevel = GOVERNOR_LIMIT_VOICES);
+  // Active voice count at GOVERNOR_LIMIT_VOICES; 0 (default) is half of the
+  // maximum active voice count
+  result setGovernorVoiceLimit(unsigned int aVoiceCount);
+  // Set the callback raised on governor level changes, NULL to remove
+  void setGovernorCallback(governorCallback aCallback, void* aUserData = 0);
   // Set behavior for inaudible sounds
   void setInaudibleBehavior(handle aVoiceHandle, bool aMustTick, bool aKill);
   // Set the global volume
@@ -371,6 +538,13 @@ class Soloud {
   void setProtectVoice(handle aVoiceHandle, bool aProtect);
   // Set the sample rate
   void setSamplerate(handle aVoiceHandle, float aSamplerate);
+  // Send the voice's post-fader signal to a return bus (a handle from
+  // playing a Bus) at aVolume; 0 as the bus handle clears the send. Effects
+  // on the return then run once for all the voices sending to it. The return
+  // hears sends one buffer late, and only from voices mixed at the output
+  // samplerate into a bus with the return's channel count.
+  result setSend(handle aVoiceHandle, unsigned int aSendId,
+    handle aReturnBusHandle, float aVolume);
   // Set panning value; -1 is left, 0 is center, 1 is right
   void setPan(handle aVoiceHandle, float aPan);
   // Set absolute left/right volumes
@@ -444,6 +618,35 @@ class Soloud {
   // Is this voice group empty?
   bool isVoiceGroupEmpty(handle aVoiceGroupHandle);
 
+  // Start a virtual voice: an emitter with only a position, volume, priority
+  // and playhead, which updateVirtualVoices() turns into a real 3d voice while
+  // it ranks among the most audible. Returns a virtual voice handle, or 0 if
+  // out of memory. Virtual voices are driven from one thread; stopAll and
+  // stopAudioSource end them too, so call those from that thread as well.
+  handle playVirtual(AudioSource& aSound, float aPosX, float aPosY,
+    float aPosZ, float aVolume = 1.0f, unsigned int aPriority = 0,
+    unsigned int aBus = 0);
+  // Stop a virtual voice and its real voice, if any
+  void stopVirtualVoice(handle aVirtualHandle);
+  // Check if the virtual voice is still playing
+  bool isValidVirtualVoice(handle aVirtualHandle);
+  void setVirtualVoicePosition(
+    handle aVirtualHandle, float aPosX, float aPosY, float aPosZ);
+  void setVirtualVoiceVolume(handle aVirtualHandle, float aVolume);
+  // Higher priorities are realized first regardless of audibility
+  void setVirtualVoicePriority(handle aVirtualHandle, unsigned int aPriority);
+  // Real voice currently playing the virtual voice, 0 if it is virtual
+  handle getVirtualVoiceRealHandle(handle aVirtualHandle);
+  // Logical play position, in seconds
+  time getVirtualVoicePlayhead(handle aVirtualHandle);
+  // Number of live virtual voices
+  unsigned int getVirtualVoiceCount();
+  // Number of real voices the virtual voices may occupy at once
+  void setVirtualVoiceLimit(unsigned int aVoiceLimit);
+  // Rank the virtual voices against the listener, realizing the most audible
+  // and releasing the rest. Call once per frame, before update3dAudio().
+  void updateVirtualVoices();
+
   // Perform 3d audio parameter update
   void update3dAudio();
 
@@ -506,8 +709,9 @@ class Soloud {
   void calcActiveVoices_internal();
   // Map resample buffers to active voices
   void mapResampleBuffers_internal();
-  // Perform mixing for a specific bus
-  void mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
+  // Perform mixing for a specific bus. Returns false if nothing audible was
+  // mixed, in which case the buffer is left cleared.
+  bool mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
     unsigned int aBufferSize, float* aScratch, unsigned int aBus,
     float aSamplerate, unsigned int aChannels, unsigned int aResampler);
   // Find a free voice, stopping the oldest if no free voice is found.
@@ -518,6 +722,12 @@ class Soloud {
   handle getHandleFromVoice_internal(unsigned int aVoice) const;
   // Stop voice (not handle).
   void stopVoice_internal(unsigned int aVoice);
+  // Stop every voice of aSound in this engine
+  void stopSourceVoices_internal(AudioSource& aSound);
+  // Slot of aSound's voice playing aInstance, -1 if it isn't playing in
+  // this engine
+  int findSourceVoice_internal(
+    AudioSource& aSound, AudioSourceInstance* aInstance);
   // Set voice (not handle) pan.
   void setVoicePan_internal(unsigned int aVoice, float aPan);
   // Set voice (not handle) relative play speed.
@@ -530,17 +740,51 @@ class Soloud {
   void updateVoiceVolume_internal(unsigned int aVoice);
   // Update overall relative play speed from set and 3d speeds
   void updateVoiceRelativePlaySpeed_internal(unsigned int aVoice);
+  // Refresh the voice state byte from the voice's flags and faders
+  void updateVoiceState_internal(unsigned int aVoice);
+  // Fold the position accumulated by the fader pass into the voice
+  void syncVoicePosition_internal(unsigned int aVoice);
+  // Republish the voice's snapshot for the lock-free getters
+  void publishVoice_internal(unsigned int aVoice);
+  // Republish every voice snapshot and the active voice count
+  void publishVoices_internal();
+  // Find the snapshot slot for a handle (voice groups resolve to their first
+  // voice); returns -1 for handles that can't name a voice.
+  int getSnapshotSlot_internal(handle& aVoiceHandle);
+  // Distance attenuation of a 3d source
+  float attenuate3d_internal(AudioAttenuator* aAttenuator,
+    unsigned int aModel, float aDistance, float aMinDistance,
+    float aMaxDistance, float aRolloffFactor);
+  // Get virtual voice index from handle, -1 if it's not live
+  int getVirtualVoiceIndex_internal(handle aVirtualHandle) const;
+  // Free a virtual voice entry, stopping its real voice
+  void releaseVirtualVoice_internal(int aIndex);
+  // Release every virtual voice of aSound, or all if aSound is NULL
+  void stopVirtualVoices_internal(AudioSource* aSound);
   // Perform 3d audio calculation for array of voices
   void update3dVoices_internal(
     unsigned int* aVoiceList, unsigned int aVoiceCount);
+  // Step the governor level from the load of the mix just finished
+  void updateGovernor_internal(float aLoad);
+  // Active voice limit after the governor's reduction
+  unsigned int getActiveVoiceLimit_internal() const;
   // Clip the samples in the buffer
   void clip_internal(AlignedFloatBuffer& aBuffer,
     AlignedFloatBuffer& aDestBuffer, unsigned int aSamples, float aVolume0,
     float aVolume1);
-  // Remove all non-active voices from group
-  void trimVoiceGroup_internal(handle aVoiceGroupHandle);
-  // Get pointer to the zero-terminated array of voice handles in a voice group
-  handle* voiceGroupHandleToArray_internal(handle aVoiceGroupHandle) const;
+  // Get voice group index from handle, -1 if it's not a live voice group
+  int getVoiceGroupIndex_internal(handle aVoiceGroupHandle) const;
+  // Release a voice group membership node
+  void releaseVoiceGroupMember_internal(int aMember);
+  // Remove voice from all the voice groups it's in
+  void leaveVoiceGroups_internal(unsigned int aVoice);
+  // Walk the voices a handle refers to: the voice itself, or the members of
+  // a voice group. aMember carries the walk state; -1 from either ends it.
+  int firstVoice_internal(handle aVoiceHandle, int& aMember) const;
+  int nextVoice_internal(int& aMember) const;
+  // As above, but only voices whose 3d data belongs to the handle
+  int first3dVoice_internal(handle aVoiceHandle, int& aMember) const;
+  int next3dVoice_internal(int& aMember) const;
 
   // Lock audio thread mutex.
   void lockAudioMutex_internal();
@@ -556,6 +800,13 @@ class Soloud {
   AlignedFloatBuffer mScratch;
   // Current size of the scratch, in samples.
   unsigned int mScratchSize;
+  // Scratch for loop-point seeks in the mixer. A bus mixing its voices
+  // directly into mScratch may be holding a partial mix there.
+  AlignedFloatBuffer mSeekScratch;
+  // Worker for seekAsync, created on first use
+  Thread::Pool* mSeekPool;
+  // Asynchronous seeks not yet finished
+  unsigned int mPendingSeeks;
   // Output scratch buffer, used in mix_().
   AlignedFloatBuffer mOutputScratch;
   // Pointers to resampler buffers, two per active voice.
@@ -626,16 +877,110 @@ class Soloud {
   // calculations without audio mutex.
   AudioSourceInstance3dData m3dData[VOICE_COUNT];
 
-  // For each voice group, first int is number of ints alocated.
-  unsigned int** mVoiceGroup;
+  // Bits of mVoiceState
+  enum VOICE_STATE {
+    // Slot holds a voice
+    VOICE_ALIVE = 1,
+    // Mirrors AudioSourceInstance::PAUSED
+    VOICE_PAUSED = 2,
+    // Mirrors AudioSourceInstance::INAUDIBLE
+    VOICE_INAUDIBLE = 4,
+    // Mirrors AudioSourceInstance::INAUDIBLE_TICK
+    VOICE_TICK = 8,
+    // A fader or scheduler may be running
+    VOICE_FADING = 16,
+    // Mirrors AudioSourceInstance::SEEKING
+    VOICE_SEEKING = 32
+  };
+
+  // Per-slot data read by the mixer every buffer, kept apart from the voice
+  // instances so the fader pass and voice ranking walk a few dense arrays.
+  // The instance stays authoritative; these mirror it.
+  unsigned char mVoiceState[VOICE_COUNT];
+  // Mirror of the voice's mOverallVolume
+  float mVoiceVolume[VOICE_COUNT];
+  // Mirror of the voice's mOverallRelativePlaySpeed
+  float mVoiceSpeed[VOICE_COUNT];
+  // How long each voice has played, in seconds.
+  time mVoiceStreamTime[VOICE_COUNT];
+  // Stream position advanced since the last syncVoicePosition_internal
+  time mVoicePositionDelta[VOICE_COUNT];
+  // Bumped each time the slot is reused; stale handles fail to match it.
+  unsigned short mVoiceGeneration[VOICE_COUNT];
+  // Per-source voice lists, so stop/count by source don't scan every slot
+  VoiceSourceLink mVoiceSourceLink[VOICE_COUNT];
+  // Live voices left out of their source's list; while there are any,
+  // lookups by source also scan the slots.
+  unsigned int mUnlistedVoices;
+  // Published voice state for the lock-free getters
+  VoiceSnapshot mVoiceSnapshot[VOICE_COUNT];
+  // Number of live voices, kept in step with the snapshots
+  std::atomic<unsigned int> mVoiceCountSnapshot;
+  // mActiveVoiceCount as of the last calcActiveVoices_internal
+  std::atomic<unsigned int> mActiveVoiceCountSnapshot;
+
+  // Voice groups, indexed by the low 12 bits of the group handle
+  VoiceGroup* mVoiceGroup;
   unsigned int mVoiceGroupCount;
+  // Pool of voice group membership nodes
+  VoiceGroupMember* mVoiceGroupMember;
+  unsigned int mVoiceGroupMemberCount;
+  // First free node in mVoiceGroupMember, -1 if the pool is full
+  int mVoiceGroupMemberFree;
+  // First group membership node of each voice, -1 if none
+  int mVoiceGroupMembership[VOICE_COUNT];
+
+  // Virtual voices; entries are recycled through a free list
+  VirtualVoice* mVirtualVoice;
+  unsigned int mVirtualVoiceCapacity;
+  // First free entry, -1 if the array is full
+  int mVirtualVoiceFree;
+  // Live virtual voices
+  unsigned int mVirtualVoiceCount;
+  unsigned int mVirtualVoiceLimit;
+  // Ranking scratch, mVirtualVoiceCapacity entries
+  unsigned int* mVirtualVoiceRank;
 
   // List of currently active voices
   unsigned int mActiveVoice[VOICE_COUNT];
   // Number of currently active voices
   unsigned int mActiveVoiceCount;
-  // Active voices list needs to be recalculated
-  bool mActiveVoiceDirty;
+  // Active voices list needs to be recalculated. Atomic so
+  // getActiveVoiceCount can tell without the mutex whether its snapshot is
+  // current.
+  std::atomic<bool> mActiveVoiceDirty;
+  // Consecutive silent samples produced with no active voices; lets global
+  // filter tails ring out before going idle.
+  unsigned int mSilentSamples;
+  // Last mix was skipped as silent, and as published for isIdle
+  bool mIdle;
+  std::atomic<bool> mIdleSnapshot;
+  // Number of mixes so far; tags the send buffers of return busses
+  unsigned int mMixCount;
+  // Samples in the current mix
+  unsigned int mMixSamples;
+  // Voices mixed directly in the current mix, and as of the last one
+  unsigned int mDirectVoices;
+  std::atomic<unsigned int> mDirectVoiceCountSnapshot;
+
+  // CPU budget governor; the level is only changed by the audio thread,
+  // which reads the settings without the audio mutex and takes it only to
+  // change the level.
+  std::atomic<bool> mGovernorEnabled;
+  unsigned int mGovernorLevel;
+  std::atomic<unsigned int> mGovernorMaxLevel;
+  std::atomic<float> mGovernorHighLoad;
+  std::atomic<float> mGovernorLowLoad;
+  std::atomic<unsigned int> mGovernorHoldBuffers;
+  // Consecutive mixes under the low load mark
+  unsigned int mGovernorCalmBuffers;
+  unsigned int mGovernorVoiceLimit;
+  governorCallback mGovernorCallback;
+  void* mGovernorUserData;
+  // mGovernorLevel as published for getGovernorLevel
+  std::atomic<unsigned int> mGovernorLevelSnapshot;
+  // Last mix time relative to the buffer duration
+  std::atomic<float> mMixLoadSnapshot;
 };
 };  // namespace SoLoud
 
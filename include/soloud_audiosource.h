@@ -118,7 +118,14 @@ class AudioSourceInstance {
     // If inaudible, should still be ticked (default = pause)
     INAUDIBLE_TICK = 128,
     // Don't auto-stop sound
-    DISABLE_AUTOSTOP = 256
+    DISABLE_AUTOSTOP = 256,
+    // This audio instance is a bus; at a matching sample rate it can be mixed
+    // without resampling
+    BUS = 512,
+    // An asynchronous seek owns this instance; the mixer leaves it alone
+    SEEKING = 1024,
+    // At least one aux send is set
+    HAS_SENDS = 2048
   };
   // Ctor
   AudioSourceInstance();
@@ -128,8 +135,9 @@ class AudioSourceInstance {
   unsigned int mPlayIndex;
   // Loop count
   unsigned int mLoopCount;
-  // Flags; see AudioSourceInstance::FLAGS
-  unsigned int mFlags;
+  // Flags; see AudioSourceInstance::FLAGS. Atomic since a SEEKING instance
+  // reads them on the seek worker while the API updates them.
+  std::atomic<unsigned int> mFlags;
   // Pan value, for getPan()
   float mPan;
   // Volume for each channel (panning)
@@ -148,9 +156,8 @@ class AudioSourceInstance {
   float mSetRelativePlaySpeed;
   // Overall relative plays peed; overall = set * 3d
   float mOverallRelativePlaySpeed;
-  // How long this stream has played, in seconds.
-  time mStreamTime;
-  // Position of this stream, in seconds.
+  // Position of this stream, in seconds. While playing, the part advanced
+  // since the last seek lives in Soloud::mVoicePositionDelta.
   time mStreamPosition;
   // Fader for the audio panning
   Fader mPanFader;
@@ -162,8 +169,6 @@ class AudioSourceInstance {
   Fader mPauseScheduler;
   // Fader used to schedule stopping of the stream
   Fader mStopScheduler;
-  // Affected by some fader
-  int mActiveFader;
   // Current channel volumes, used to ramp the volume changes to avoid clicks
   float mCurrentChannelVolume[MAX_CHANNELS];
   // ID of the sound source that generated this instance
@@ -172,10 +177,18 @@ class AudioSourceInstance {
   unsigned int mBusHandle;
   // Filter pointer
   FilterInstance* mFilter[FILTERS_PER_STREAM];
+  // Filters the governor may skip, one bit per filter slot
+  unsigned int mOptionalFilters;
+  // Aux sends: return bus handles (0 for unused) and their volumes
+  handle mSendBus[SENDS_PER_VOICE];
+  float mSendVolume[SENDS_PER_VOICE];
   // Initialize instance. Mostly internal use.
   void init(AudioSource& aSource, int aPlayIndex);
   // Pointers to buffers for the resampler
   float* mResampleData[2];
+  // Silence flags for the resampler buffers; bit 0 is mResampleData[0], bit 1
+  // is mResampleData[1]
+  unsigned int mResampleSilence;
   // Sub-sample playhead; 16.16 fixed point
   unsigned int mSrcOffset;
   // Samples left over from earlier pass
@@ -184,6 +197,12 @@ class AudioSourceInstance {
   unsigned int mDelaySamples;
   // When looping, start playing from this time
   time mLoopPoint;
+  // Target requested while an asynchronous seek was running, -1 if none
+  time mPendingSeek;
+  // Base samplerate and loop point set while an asynchronous seek was
+  // running, applied when it lands; -1 if none
+  float mPendingBaseSamplerate;
+  time mPendingLoopPoint;
 
   // Get N samples from the stream to the buffer. Report samples written.
   virtual unsigned int getAudio(
@@ -199,6 +218,15 @@ class AudioSourceInstance {
   virtual result rewind();
   // Get information. Returns 0 by default.
   virtual float getInfo(unsigned int aInfoKey);
+  // Direct access for sources whose samples sit in memory as non-interleaved
+  // floats, letting the mixer skip getAudio and the resampler. Returns the
+  // data at the play position (aChannelStride floats between channels), how
+  // many samples can be read from it and how many precede it, or NULL (the
+  // default) if not supported.
+  virtual const float* getDirectData(unsigned int& aSamples,
+    unsigned int& aHistory, unsigned int& aChannelStride);
+  // Advance the play position after the mixer read aSamples directly
+  virtual void skipDirectData(unsigned int aSamples);
 };
 
 class Soloud;
@@ -260,8 +288,22 @@ class AudioSource {
   float m3dDopplerFactor;
   // Filter pointer
   Filter* mFilter[FILTERS_PER_STREAM];
+  // Filters the governor may skip, one bit per filter slot
+  unsigned int mOptionalFilters;
   // Pointer to the Soloud object. Needed to stop all instances in dtor.
   Soloud* mSoloud;
+  // Slot of the most recently started live voice of this source, -1 if none.
+  // The others follow through Soloud::mVoiceSourceLink of mVoiceListOwner,
+  // the engine whose slots these are. An engine claims the list when it is
+  // empty and gives it up when its last voice stops; voices started in other
+  // engines meanwhile are left out of it.
+  int mFirstVoice;
+  std::atomic<Soloud*> mVoiceListOwner;
+  // Number of live virtual voices playing this source
+  unsigned int mVirtualVoices;
+  // Asynchronous seeks still running on instances of this source; stopping
+  // the source waits for them
+  unsigned int mPendingSeeks;
   // Pointer to a custom audio collider object
   AudioCollider* mCollider;
   // Pointer to custom attenuator object
@@ -312,10 +354,15 @@ class AudioSource {
 
   // Set filter. Set to NULL to clear the filter.
   virtual void setFilter(unsigned int aFilterId, Filter* aFilter);
+  // Mark a filter as optional: the CPU budget governor may skip it on new
+  // instances when it runs short of time.
+  void setFilterOptional(unsigned int aFilterId, bool aOptional);
   // DTor
   virtual ~AudioSource();
   // Create instance from the audio source. Called from within Soloud class.
   virtual AudioSourceInstance* createInstance() = 0;
+  // Length in seconds, 0 if unknown or endless
+  virtual time getLength();
   // Stop all instances of this audio source
   void stop();
 };
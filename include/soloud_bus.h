@@ -41,7 +41,31 @@ class BusInstance : public AudioSourceInstance {
   // Mono-mixed wave data for visualization and for visualization FFT input
   float mVisualizationWaveData[256];
 
+  // Aux send accumulation when this bus is a return. The two halves
+  // alternate between mixes: sends fill the current mix's half while the
+  // bus plays back the previous one.
+  AlignedFloatBuffer mSendBuffer;
+  // Mix count each half was written in, samples written and their stride
+  unsigned int mSendMix[2];
+  unsigned int mSendSamples[2];
+  unsigned int mSendStride[2];
+  // Mix being played back from the send buffer and how far it has got
+  unsigned int mSendReadMix;
+  unsigned int mSendReadOffset;
+
   BusInstance(Bus* aParent);
+  // Allocate the send buffer before the first send targets this bus. Called
+  // under the audio mutex.
+  void initSendBuffer();
+  // Half of the send buffer for the mix aMix, cleared on first use
+  float* getSendTarget(
+    unsigned int aMix, unsigned int aSamples, unsigned int aStride);
+  // Add the previous mix's sends to aBuffer; false if there was nothing
+  bool readSends(
+    float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
+  // Rate the children are mixed at: mSamplerate, halved by the governor for
+  // busses with a reduced internal samplerate.
+  float getMixSamplerate() const;
   virtual unsigned int getAudio(
     float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
   virtual bool hasEnded();
@@ -72,6 +96,11 @@ class Bus : public AudioSource {
     float aVelZ = 0.0f, float aVolume = 1.0f);
   // Set number of channels for the bus (default 2)
   result setChannels(unsigned int aChannels);
+  // Set the internal samplerate of the bus. Children are resampled to this
+  // rate and the bus output is resampled once into its parent. Lower rates
+  // trade quality for mixing cost. 0 (default) follows the output rate.
+  // Takes effect the next time the bus is played.
+  result setSamplerate(float aSamplerate);
   // Enable or disable visualization data gathering
   void setVisualizationEnable(bool aEnable);
   // Move a live sound to this bus
@@ -101,6 +130,8 @@ class Bus : public AudioSource {
   BusInstance* mInstance;
   unsigned int mChannelHandle;
   unsigned int mResampler;
+  // Internal samplerate, or 0 to run at the output rate
+  float mInternalSamplerate;
   // FFT output data
   float mFFTData[256];
   // Snapshot of wave data for visualization
@@ -88,6 +88,27 @@ class MemoryFile : public File {
   result openToMem(const char* aFilename);
   result openFileToMem(File* aFile);
 };
+
+// Read-only memory mapping of a file. Decoders that take getMemPtr() read
+// straight from the page cache, and processes mapping the same file share
+// its pages. Files must be non-empty and under 4GB.
+class MmapFile : public File {
+ public:
+  const unsigned char* mDataPtr;
+  unsigned int mDataLength;
+  unsigned int mOffset;
+
+  virtual int eof();
+  virtual unsigned int read(unsigned char* aDst, unsigned int aBytes);
+  virtual unsigned int length();
+  virtual void seek(int aOffset);
+  virtual unsigned int pos();
+  virtual const unsigned char* getMemPtr();
+  virtual ~MmapFile();
+  MmapFile();
+  result open(const char* aFilename);
+  void close();
+};
 };  // namespace SoLoud
 
 #endif
@@ -52,6 +52,10 @@ class FilterInstance {
     unsigned int aAttributeId, float aTo, time aTime, time aStartTime);
   virtual void oscillateFilterParameter(unsigned int aAttributeId, float aFrom,
     float aTo, time aTime, time aStartTime);
+  // Whether the filter may output sound from silent input (delay lines,
+  // resonance, held state). Filters that return false are skipped on silent
+  // blocks.
+  virtual bool hasTail();
   virtual ~FilterInstance();
 };
 
@@ -126,66 +126,75 @@ void interlace_samples_float(const float* aSourceBuffer, float* aDestBuffer,
 // 12121212
 void interlace_samples_s16(const float* aSourceBuffer, short* aDestBuffer,
   unsigned int aSamples, unsigned int aChannels, unsigned int aStride);
+
+// Whether a channel count is a supported output layout. Up to 8 channels only
+// the standard layouts are allowed; above that any count up to MAX_CHANNELS.
+inline bool isValidChannelCount(unsigned int aChannels) {
+  if (aChannels == 0 || aChannels > MAX_CHANNELS) {
+    return false;
+  }
+  return aChannels > 8 || !(aChannels == 3 || aChannels == 5 || aChannels == 7);
+}
 };  // namespace SoLoud
 
-#define FOR_ALL_VOICES_PRE                             \
-  handle* h_ = NULL;                                   \
-  handle th_[2] = {aVoiceHandle, 0};                   \
-  lockAudioMutex_internal();                           \
-  h_ = voiceGroupHandleToArray_internal(aVoiceHandle); \
-  if (h_ == NULL)                                      \
-    h_ = th_;                                          \
-  while (*h_) {                                        \
-    int ch = getVoiceFromHandle_internal(*h_);         \
-    if (ch != -1) {
-#define FOR_ALL_VOICES_POST \
-  }                         \
-  h_++;                     \
-  }                         \
+// Walk every voice a handle refers to: the voice itself, or each member of
+// a voice group. Members stopped by the loop body drop out of the walk.
+#define FOR_ALL_VOICES_PRE                                     \
+  lockAudioMutex_internal();                                   \
+  {                                                            \
+    int m_;                                                    \
+    int ch;                                                    \
+    for (ch = firstVoice_internal(aVoiceHandle, m_); ch != -1; \
+      ch = nextVoice_internal(m_)) {
+#define FOR_ALL_VOICES_POST  \
+  publishVoice_internal(ch); \
+  }                          \
+  }                          \
   unlockAudioMutex_internal();
 
-#define FOR_ALL_VOICES_PRE_3D                          \
-  handle* h_ = NULL;                                   \
-  handle th_[2] = {aVoiceHandle, 0};                   \
-  h_ = voiceGroupHandleToArray_internal(aVoiceHandle); \
-  if (h_ == NULL)                                      \
-    h_ = th_;                                          \
-  while (*h_) {                                        \
-    int ch = (*h_ & 0xfff) - 1;                        \
-    if (ch != -1 && m3dData[ch].mHandle == *h_) {
-#define FOR_ALL_VOICES_POST_3D \
-  }                            \
-  h_++;                        \
+// 3d variant: only voices with 3d data. A single handle is resolved without
+// the audio mutex; walking a voice group needs it.
+#define FOR_ALL_VOICES_PRE_3D                                    \
+  {                                                              \
+    bool lock_ = (aVoiceHandle & 0xfffff000) == 0xfffff000;      \
+    if (lock_)                                                   \
+      lockAudioMutex_internal();                                 \
+    int m_;                                                      \
+    int ch;                                                      \
+    for (ch = first3dVoice_internal(aVoiceHandle, m_); ch != -1; \
+      ch = next3dVoice_internal(m_)) {
+#define FOR_ALL_VOICES_POST_3D   \
+  }                              \
+  if (lock_)                     \
+    unlockAudioMutex_internal(); \
   }
 
-#define FOR_ALL_VOICES_PRE_EXT                                  \
-  handle* h_ = NULL;                                            \
-  handle th_[2] = {aVoiceHandle, 0};                            \
-  mSoloud->lockAudioMutex_internal();                           \
-  h_ = mSoloud->voiceGroupHandleToArray_internal(aVoiceHandle); \
-  if (h_ == NULL)                                               \
-    h_ = th_;                                                   \
-  while (*h_) {                                                 \
-    int ch = mSoloud->getVoiceFromHandle_internal(*h_);         \
-    if (ch != -1) {
-#define FOR_ALL_VOICES_POST_EXT \
-  }                             \
-  h_++;                         \
-  }                             \
+#define FOR_ALL_VOICES_PRE_EXT                                          \
+  mSoloud->lockAudioMutex_internal();                                   \
+  {                                                                     \
+    int m_;                                                             \
+    int ch;                                                             \
+    for (ch = mSoloud->firstVoice_internal(aVoiceHandle, m_); ch != -1; \
+      ch = mSoloud->nextVoice_internal(m_)) {
+#define FOR_ALL_VOICES_POST_EXT       \
+  mSoloud->publishVoice_internal(ch); \
+  }                                   \
+  }                                   \
   mSoloud->unlockAudioMutex_internal();
 
-#define FOR_ALL_VOICES_PRE_3D_EXT                      \
-  handle* h_ = NULL;                                   \
-  handle th_[2] = {aVoiceHandle, 0};                   \
-  h_ = mSoloud->voiceGroupHandleToArray(aVoiceHandle); \
-  if (h_ == NULL)                                      \
-    h_ = th_;                                          \
-  while (*h_) {                                        \
-    int ch = (*h_ & 0xfff) - 1;                        \
-    if (ch != -1 && mSoloud->m3dData[ch].mHandle == *h_) {
-#define FOR_ALL_VOICES_POST_3D_EXT \
-  }                                \
-  h_++;                            \
+#define FOR_ALL_VOICES_PRE_3D_EXT                                         \
+  {                                                                       \
+    bool lock_ = (aVoiceHandle & 0xfffff000) == 0xfffff000;               \
+    if (lock_)                                                            \
+      mSoloud->lockAudioMutex_internal();                                 \
+    int m_;                                                               \
+    int ch;                                                               \
+    for (ch = mSoloud->first3dVoice_internal(aVoiceHandle, m_); ch != -1; \
+      ch = mSoloud->next3dVoice_internal(m_)) {
+#define FOR_ALL_VOICES_POST_3D_EXT        \
+  }                                       \
+  if (lock_)                              \
+    mSoloud->unlockAudioMutex_internal(); \
   }
 
 #endif
@@ -40,6 +40,7 @@ class RobotizeFilterInstance : public FilterInstance {
   virtual void filterChannel(float* aBuffer, unsigned int aSamples,
     float aSamplerate, time aTime, unsigned int aChannel,
     unsigned int aChannels);
+  virtual bool hasTail();
   RobotizeFilterInstance(RobotizeFilter* aParent);
 };
 
@@ -0,0 +1,90 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2020 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#ifndef SOLOUD_RTCHECK_H
+#define SOLOUD_RTCHECK_H
+
+// Real-time safety checker. Build the library with SOLOUD_RT_CHECK defined to
+// have heap allocation, mutex waits, sleeps and file I/O made by the mixer
+// thread reported while it is inside mix_internal. Without the define every
+// hook below compiles away.
+
+#ifdef SOLOUD_RT_CHECK
+#include <typeinfo>
+#endif
+
+namespace SoLoud {
+namespace RtCheck {
+enum VIOLATION {
+  ALLOCATION = 0,
+  DEALLOCATION,
+  MUTEX_WAIT,
+  SLEEP,
+  FILE_IO
+};
+
+// Called for each violation. aContext is the chain of audio sources and
+// filters being mixed, outermost first ("" if none); aFrames holds
+// aFrameCount return addresses (0 where backtraces aren't available).
+// Allocating in the callback is fine, it isn't checked.
+typedef void (*violationCallback)(VIOLATION aViolation, const char* aContext,
+  void* const* aFrames, int aFrameCount, void* aUserData);
+
+// Scope of an object being mixed, named in violation reports
+class Scope {
+ public:
+  Scope(const char* aName);
+  ~Scope();
+  const char* mName;
+  Scope* mParent;
+};
+
+// Replace the default reporter, which prints to stderr. NULL restores it.
+void setViolationCallback(violationCallback aCallback, void* aUserData);
+// Mark the calling thread as being inside the mix; calls nest
+void enterMixer();
+void leaveMixer();
+bool isInMixer();
+// Report aViolation if the calling thread is inside the mix
+void check(VIOLATION aViolation);
+// Number of violations reported since startup
+unsigned int getViolationCount();
+const char* getViolationName(VIOLATION aViolation);
+}  // namespace RtCheck
+}  // namespace SoLoud
+
+#ifdef SOLOUD_RT_CHECK
+#define SOLOUD_RT_ENTER_MIXER() SoLoud::RtCheck::enterMixer()
+#define SOLOUD_RT_LEAVE_MIXER() SoLoud::RtCheck::leaveMixer()
+#define SOLOUD_RT_CHECK_CALL(x) SoLoud::RtCheck::check(SoLoud::RtCheck::x)
+#define SOLOUD_RT_SCOPE(x) \
+  SoLoud::RtCheck::Scope soloud_rt_scope_(typeid(x).name())
+#else
+#define SOLOUD_RT_ENTER_MIXER()
+#define SOLOUD_RT_LEAVE_MIXER()
+#define SOLOUD_RT_CHECK_CALL(x)
+#define SOLOUD_RT_SCOPE(x)
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#ifndef SOLOUD_SAMPLECACHE_H
+#define SOLOUD_SAMPLECACHE_H
+
+#include "soloud.h"
+#include "soloud_wav.h"
+
+namespace SoLoud {
+class SoundBank;
+
+// Owns Wavs for files and sound bank entries and keeps their samples within
+// a byte budget. Sounds are loaded on first use; when over budget the least
+// recently played ones without live or virtual voices are unloaded, and
+// loaded again the next time they're played.
+class SampleCache {
+ public:
+  SampleCache();
+  ~SampleCache();
+  // A budget of 0 means no limit. With aAsyncReload, loads return at once
+  // and decode in the background (see Wav::setProgressiveLoad).
+  result init(Soloud* aSoloud, unsigned int aBudgetBytes,
+    bool aAsyncReload = false);
+  void setBudget(unsigned int aBudgetBytes);
+  unsigned int getBudget();
+  void setAsyncReload(bool aAsync);
+  // Sample format for loads from here on (Wav::SAMPLE_FORMAT)
+  result setSampleFormat(unsigned int aFormat);
+
+  // Register a sound without loading it. Returns its id, the existing one
+  // if it is already registered, or -1.
+  int add(const char* aFilename);
+  // The bank must outlive the cache
+  int addBank(SoundBank* aBank, const char* aName);
+  int find(const char* aFilename);
+  int findBank(SoundBank* aBank, const char* aName);
+
+  // Play sound aId, loading it first if needed; 0 if it fails to load
+  handle play(int aId, float aVolume = -1.0f, float aPan = 0.0f,
+    bool aPaused = false, unsigned int aBus = 0);
+  // The sound's Wav, loaded and marked as used; 0 if it fails to load. The
+  // samples may be unloaded again by later loads unless it has voices.
+  Wav* get(int aId);
+  bool isResident(int aId);
+  // Result of the sound's last load
+  result getLoadResult(int aId);
+  // Unload idle sounds until within budget, e.g. after voices have ended
+  void trim();
+  // Unload every idle sound
+  void unloadAll();
+
+  unsigned int getResidentBytes();
+  unsigned int getResidentCount();
+  unsigned int getCount();
+  // Uses of a loaded sound, uses that had to load, and sounds unloaded to
+  // stay within budget
+  unsigned int getHitCount();
+  unsigned int getMissCount();
+  unsigned int getEvictionCount();
+  void resetStats();
+
+  struct Entry {
+    Wav mWav;
+    char* mFilename;
+    SoundBank* mBank;
+    char* mName;
+    unsigned int mBytes;
+    bool mResident;
+    result mResult;
+    // Resident entries, most recently used first
+    Entry* mPrev;
+    Entry* mNext;
+  };
+
+  Entry* use_internal(int aId);
+  bool evict_internal(Entry* aEntry);
+  void trim_internal(Entry* aKeep);
+
+  Soloud* mSoloud;
+  Entry** mEntries;
+  unsigned int mCount;
+  unsigned int mCapacity;
+  Entry* mHead;
+  Entry* mTail;
+  unsigned int mBudget;
+  unsigned int mResidentBytes;
+  unsigned int mResidentCount;
+  unsigned int mFormat;
+  bool mAsync;
+  unsigned int mHits;
+  unsigned int mMisses;
+  unsigned int mEvictions;
+};
+};  // namespace SoLoud
+
+#endif
@@ -0,0 +1,137 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#ifndef SOLOUD_SOUNDBANK_H
+#define SOLOUD_SOUNDBANK_H
+
+#include "soloud.h"
+
+// A sound bank packs many sounds into one file behind a hashed name index, so
+// a title maps a single file instead of opening thousands. Little endian:
+//
+//   SoundBankHeader
+//   mBucketCount u32 buckets, entry index + 1 or 0 if empty, linear probing
+//   mEntryCount SoundBankEntry records
+//   NUL-terminated entry names
+//   entry payloads, each aligned to SOLOUD_SOUNDBANK_ALIGN
+//
+// Payloads are whole files Wav and WavStream can parse: encoded (ogg, mp3,
+// flac, wav) or pre-decoded 32-bit float wav.
+
+#define SOLOUD_SOUNDBANK_MAGIC 0x4b424c53  // "SLBK"
+#define SOLOUD_SOUNDBANK_VERSION 1
+#define SOLOUD_SOUNDBANK_ALIGN 16
+
+namespace SoLoud {
+class File;
+
+struct SoundBankHeader {
+  unsigned int mMagic;
+  unsigned int mVersion;
+  unsigned int mEntryCount;
+  unsigned int mBucketCount;  // power of two
+  unsigned int mBucketOffset;
+  unsigned int mEntryOffset;
+  unsigned int mNameOffset;
+  unsigned int mNameLength;
+};
+
+struct SoundBankEntry {
+  unsigned int mHash;
+  unsigned int mNameOffset;  // from the start of the name block
+  unsigned int mDataOffset;  // from the start of the bank
+  unsigned int mDataLength;
+  unsigned int mType;
+  unsigned int mReserved[3];
+};
+
+class SoundBank {
+ public:
+  enum ENTRY_TYPE {
+    // Compressed or otherwise encoded file as packed
+    ENCODED = 0,
+    // Decoded to 32-bit float wav at pack time
+    PCM = 1
+  };
+
+  SoundBank();
+  ~SoundBank();
+  // Map a bank file
+  result load(const char* aFilename);
+  result loadMem(const unsigned char* aData, unsigned int aLength,
+    bool aCopy = false, bool aTakeOwnership = true);
+  // Banks must be memory-backed; other files are read into memory
+  result loadFile(File* aFile);
+  void close();
+  // Entry index of aName, or -1
+  int find(const char* aName);
+  unsigned int getEntryCount();
+  const char* getEntryName(unsigned int aIndex);
+  const unsigned char* getEntryData(unsigned int aIndex);
+  unsigned int getEntryLength(unsigned int aIndex);
+  unsigned int getEntryType(unsigned int aIndex);
+  // FNV-1a of the entry name
+  static unsigned int hash(const char* aName);
+
+  File* mFile;
+  const unsigned char* mData;
+  unsigned int mLength;
+  const SoundBankHeader* mHeader;
+  const unsigned int* mBuckets;
+  const SoundBankEntry* mEntries;
+  const char* mNames;
+
+ private:
+  result parse_internal();
+};
+
+// Offline packer. Entries are written in the order they were added.
+class SoundBankWriter {
+ public:
+  SoundBankWriter();
+  ~SoundBankWriter();
+  result addEntry(const char* aName, const unsigned char* aData,
+    unsigned int aLength, unsigned int aType = SoundBank::ENCODED,
+    bool aCopy = true);
+  // Pack a file from disk under aName
+  result addFile(const char* aName, const char* aFilename);
+  unsigned int getEntryCount();
+  // Names must be unique; returns INVALID_PARAMETER on a duplicate
+  result save(const char* aFilename);
+  void clear();
+
+  struct Item {
+    char* mName;
+    const unsigned char* mData;
+    unsigned int mLength;
+    unsigned int mType;
+    bool mOwned;
+  };
+  Item* mItems;
+  unsigned int mCount;
+  unsigned int mCapacity;
+};
+};  // namespace SoLoud
+
+#endif
@@ -50,6 +50,7 @@ int getTimeMillis();
 
 class PoolTask {
  public:
+  virtual ~PoolTask() {}
   virtual void work() = 0;
 };
 
@@ -25,6 +25,8 @@ freely, subject to the following restrictions:
 #ifndef SOLOUD_WAV_H
 #define SOLOUD_WAV_H
 
+#include <atomic>
+
 #include "soloud.h"
 
 struct stb_vorbis;
@@ -33,29 +35,93 @@ namespace SoLoud {
 class Wav;
 class File;
 class MemoryFile;
+class SoundBank;
+struct WavDecodeJob;
+
+// Frames per channel in one FORMAT_ADPCM block, and the block's size:
+// a 16-bit predictor, a step index, a pad byte, then a nibble per frame
+#define WAV_ADPCM_BLOCK 512
+#define WAV_ADPCM_BLOCK_BYTES (4 + WAV_ADPCM_BLOCK / 2)
 
 class WavInstance : public AudioSourceInstance {
   Wav* mParent;
   unsigned int mOffset;
+  // FORMAT_ADPCM decoder state per channel, valid at frame mAdpcmOffset
+  unsigned int mAdpcmOffset;
+  int mAdpcmPredictor[MAX_CHANNELS];
+  int mAdpcmIndex[MAX_CHANNELS];
+
+  void getAdpcm_internal(float* aBuffer, unsigned int aSamples,
+    unsigned int aBufferSize);
 
  public:
   WavInstance(Wav* aParent);
   virtual unsigned int getAudio(
     float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize);
   virtual result rewind();
+  virtual result seek(double aSeconds, float* aScratch,
+    unsigned int aScratchSize);
   virtual bool hasEnded();
+  virtual const float* getDirectData(unsigned int& aSamples,
+    unsigned int& aHistory, unsigned int& aChannelStride);
+  virtual void skipDirectData(unsigned int aSamples);
 };
 
 class Wav : public AudioSource {
-  result loadwav(MemoryFile* aReader);
-  result loadogg(MemoryFile* aReader);
-  result loadmp3(MemoryFile* aReader);
-  result loadflac(MemoryFile* aReader);
-  result testAndLoadFile(MemoryFile* aReader);
+  // Takes ownership of aSource, the file aReader's memory belongs to
+  result testAndLoadFile(MemoryFile* aReader, File* aSource = 0);
+  result loadCache_internal(unsigned long long aKey, unsigned int aLength);
+  void storeCache_internal(unsigned long long aKey, unsigned int aLength);
+  void freeData_internal();
+  result convert_internal();
 
  public:
+  enum SAMPLE_FORMAT {
+    // 32-bit float in mData
+    FORMAT_FLOAT = 0,
+    // Signed 16-bit in mCompactData
+    FORMAT_S16,
+    // Unsigned 8-bit in mCompactData
+    FORMAT_U8,
+    // 4-bit IMA ADPCM in WAV_ADPCM_BLOCK frame blocks in mCompactData
+    FORMAT_ADPCM
+  };
+
+  // Samples, channel after channel; 0 unless mSampleFormat is FORMAT_FLOAT
   float* mData;
   unsigned int mSampleCount;
+  // Mapping the samples live in when they came from the decode cache, else 0
+  File* mDataFile;
+  unsigned int mSampleFormat;
+  // Samples in compact formats, channel after channel
+  unsigned char* mCompactData;
+  // Frames per channel decoded so far; mSampleCount unless a progressive
+  // load is still running
+  std::atomic<unsigned int> mReadySamples;
+  // Decoder of a load in progress, 0 when done
+  WavDecodeJob* mDecodeJob;
+  bool mProgressive;
+
+  // Keep decoded Ogg, MP3 and FLAC as PCM files in aDirectory, keyed by
+  // content, and map them on later loads instead of decoding. 0 (default)
+  // disables the cache. Set before loading; the directory must exist.
+  static void setDecodeCache(const char* aDirectory);
+
+  // Keep samples in aFormat, converting the current ones. Later loads
+  // convert after decoding; compact formats trade a little mixing time for
+  // 2x (FORMAT_S16) to 8x (FORMAT_ADPCM) less memory.
+  result setSampleFormat(unsigned int aFormat);
+  // Bytes the samples take up
+  unsigned int getDataSize();
+
+  // Let later Ogg, MP3, FLAC and wav loads return once the header is read,
+  // decoding the rest front to back on a background thread. Voices play the
+  // decoded part and hold on silence if they catch up with the decoder.
+  void setProgressiveLoad(bool aEnable);
+  // True while a progressive load is still decoding
+  bool isDecoding();
+  // Decode whatever a progressive load has left on the calling thread
+  void finishDecode();
 
   Wav();
   virtual ~Wav();
@@ -63,6 +129,8 @@ class Wav : public AudioSource {
   result loadMem(const unsigned char* aMem, unsigned int aLength,
     bool aCopy = false, bool aTakeOwnership = true);
   result loadFile(File* aFile);
+  // Load the entry named aName straight from the bank's memory
+  result loadBank(SoundBank* aBank, const char* aName);
   result loadRawWave8(unsigned char* aMem, unsigned int aLength,
     float aSamplerate = 44100.0f, unsigned int aChannels = 1);
   result loadRawWave16(short* aMem, unsigned int aLength,
@@ -72,7 +140,18 @@ class Wav : public AudioSource {
     bool aCopy = false, bool aTakeOwnership = true);
 
   virtual AudioSourceInstance* createInstance();
-  time getLength();
+  virtual time getLength();
+
+  // Move aFrom's samples into this sound, stopping its voices, in one step
+  // under aSoloud's audio mutex. aFrom is left holding the old samples.
+  void takeData_internal(Wav& aFrom, Soloud* aSoloud);
+  // Decode the next chunk of mDecodeJob; false once all frames are in
+  bool decodeChunk_internal();
+  // Publish a fully decoded job, taken off mDecodeJob, write its cache file
+  // and free it
+  void completeDecode_internal(WavDecodeJob* aJob);
+  // Drop a progressive load in progress, leaving its frames undecoded
+  void cancelDecode_internal();
 };
 };  // namespace SoLoud
 
@@ -37,6 +37,7 @@ class WaveShaperFilterInstance : public FilterInstance {
   virtual void filterChannel(float* aBuffer, unsigned int aSamples,
     float aSamplerate, time aTime, unsigned int aChannel,
     unsigned int aChannels);
+  virtual bool hasTail();
   virtual ~WaveShaperFilterInstance();
   WaveShaperFilterInstance(WaveShaperFilter* aParent);
 };
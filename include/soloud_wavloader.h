@@ -0,0 +1,97 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#ifndef SOLOUD_WAVLOADER_H
+#define SOLOUD_WAVLOADER_H
+
+#include <atomic>
+
+#include "soloud.h"
+#include "soloud_thread.h"
+
+namespace SoLoud {
+class Wav;
+class File;
+
+// Decodes a batch of Wavs concurrently on a thread pool. Each Wav is
+// published in one step once decoded, so a concurrent play() sees either the
+// old samples or the new ones, never a partial load.
+class WavLoader {
+ public:
+  // Called on a worker thread as each item finishes, possibly on several at
+  // once; aDone counts finished items including this one
+  typedef void (*loadCallback)(Wav* aWav, result aResult, unsigned int aDone,
+    unsigned int aTotal, void* aUserData);
+
+  WavLoader();
+  // Waits for a started batch to finish
+  ~WavLoader();
+  // Decode on aThreadCount threads; with 0, start() decodes on the caller.
+  // Loaded sounds are published under aSoloud's audio mutex.
+  result init(Soloud* aSoloud, int aThreadCount);
+  void setCallback(loadCallback aCallback, void* aUserData);
+  // Queue a load. Only allowed before start() or after wait().
+  result add(Wav* aWav, const char* aFilename);
+  // aFile is read on a worker thread, so don't share it between items
+  result add(Wav* aWav, File* aFile);
+  // Begin decoding everything queued
+  result start();
+  bool isDone();
+  unsigned int getDoneCount();
+  unsigned int getCount();
+  // Block until the batch is done; returns the first failure, if any
+  result wait();
+  // Result of item aIndex once the batch is done
+  result getResult(unsigned int aIndex);
+  // Forget the finished batch
+  void clear();
+
+  struct Item {
+    Wav* mWav;
+    char* mFilename;
+    File* mFile;
+    result mResult;
+  };
+
+  // Worker loop, pulls items until none are left
+  void work_internal();
+
+  Soloud* mSoloud;
+  Thread::Pool* mPool;
+  Thread::PoolTask** mTasks;
+  int mThreadCount;
+  loadCallback mCallback;
+  void* mUserData;
+  Item* mItems;
+  unsigned int mCount;
+  unsigned int mCapacity;
+  bool mStarted;
+  std::atomic<unsigned int> mNext;
+  std::atomic<unsigned int> mDone;
+  // Tasks still running; the batch is done when this reaches 0
+  std::atomic<int> mActive;
+};
+};  // namespace SoLoud
+
+#endif
@@ -27,6 +27,8 @@ freely, subject to the following restrictions:
 
 #include <stdio.h>
 
+#include <atomic>
+
 #include "soloud.h"
 
 struct stb_vorbis;
@@ -43,11 +45,27 @@ struct drwav;
 namespace SoLoud {
 class WavStream;
 class File;
+class SoundBank;
+
+// Codec and decode-ahead ring of a WavStreamInstance. Kept apart from the
+// instance so that an instance destroyed while the decode-ahead worker is
+// busy with its chunk can leave the worker to free this once done, instead
+// of waiting for it under the audio mutex.
+class WavStreamDecoder {
+ public:
+  WavStreamDecoder(WavStream* aParent);
+  ~WavStreamDecoder();
 
-class WavStreamInstance : public AudioSourceInstance {
   WavStream* mParent;
+  // Copied from the parent at creation
+  int mFiletype;
+  unsigned int mSampleCount;
+  float mBaseSamplerate;
+  unsigned int mChannels;
   unsigned int mOffset;
   File* mFile;
+  // mFile is the parent's stream file, which the parent owns
+  bool mSharedFile;
   union codec {
     stb_vorbis* mOgg;
     drflac* mFlac;
@@ -58,6 +76,67 @@ class WavStreamInstance : public AudioSourceInstance {
   unsigned int mOggFrameOffset;
   float** mOggOutputs;
 
+  // Decode-ahead ring (see WavStream::setDecodeAhead), NULL when the codec
+  // runs in getAudio. Deinterleaved, mRingFrames (a power of two) frames per
+  // channel. The worker owns the codec and advances mRingWrite; the mixer
+  // only copies out and advances mRingRead.
+  float* mRing;
+  unsigned int mRingFrames;
+  std::atomic<unsigned int> mRingWrite;
+  std::atomic<unsigned int> mRingRead;
+  // Write position where the stream ended
+  std::atomic<unsigned int> mRingEnd;
+  std::atomic<bool> mRingEnded;
+  // Write position where the worker looped back to the loop point; the
+  // mixer's loop seek there is absorbed instead of restarting the codec.
+  std::atomic<unsigned int> mRingLoopMark;
+  std::atomic<bool> mRingLoopPending;
+  // Mirrors of the looping state for the worker
+  std::atomic<bool> mRingLooping;
+  std::atomic<double> mRingLoopPoint;
+  // Seeks: the mixer side bumps mSeekSerial, the worker seeks the codec and
+  // answers with mSeekAck once mRingSeekStart marks the first frame after it
+  // and mSeekLanded holds the position it actually landed on.
+  std::atomic<double> mSeekTarget;
+  std::atomic<double> mSeekLanded;
+  std::atomic<unsigned int> mSeekSerial;
+  std::atomic<unsigned int> mSeekAck;
+  std::atomic<unsigned int> mRingSeekStart;
+
+  // Neighbours in the decode-ahead worker's list
+  WavStreamDecoder* mDecodeNext;
+  WavStreamDecoder* mDecodePrev;
+  // The instance is gone; the worker frees this after its current chunk
+  bool mDead;
+
+  // Run the codec: decode, rewind and seek
+  unsigned int decode_internal(
+    float* aBuffer, unsigned int aSamples, unsigned int aPitch);
+  void rewindCodec_internal();
+  // Seek FLAC, MP3 or wav to aFrame in the codec; false if it can't
+  bool seekNative_internal(unsigned int aFrame);
+  void seekCodec_internal(double aSeconds, float* aScratch,
+    unsigned int aScratchFrames);
+  // Decode one chunk into the ring; called by the worker. aScratch holds
+  // DECODE_AHEAD_CHUNK frames per channel. Returns false if there was
+  // nothing to do.
+  bool fillRing_internal(float* aScratch, bool aHandleEnd);
+};
+
+class WavStreamInstance : public AudioSourceInstance {
+  WavStream* mParent;
+  WavStreamDecoder* mDecoder;
+  // Last seek serial whose data the mixer side has switched to
+  unsigned int mSeekSeen;
+  // Seconds of silence played while waiting for the current seek
+  double mSeekHeld;
+  // Buffers the mixer had to pad with silence, and the frames padded
+  unsigned int mStarvations;
+  unsigned int mStarvedSamples;
+
+  unsigned int getRingAudio_internal(
+    float* aBuffer, unsigned int aSamples, unsigned int aBufferSize);
+
  public:
   WavStreamInstance(WavStream* aParent);
   virtual unsigned int getAudio(
@@ -66,6 +145,7 @@ class WavStreamInstance : public AudioSourceInstance {
     double aSeconds, float* mScratch, unsigned int mScratchSize);
   virtual result rewind();
   virtual bool hasEnded();
+  virtual float getInfo(unsigned int aInfoKey);
   virtual ~WavStreamInstance();
 };
 
@@ -76,6 +156,9 @@ enum WAVSTREAM_FILETYPE {
   WAVSTREAM_MP3 = 3
 };
 
+// Frames the decode-ahead worker decodes per instance per pass
+#define DECODE_AHEAD_CHUNK 1024
+
 class WavStream : public AudioSource {
   result loadwav(File* fp);
   result loadogg(File* fp);
@@ -83,11 +166,29 @@ class WavStream : public AudioSource {
   result loadmp3(File* fp);
 
  public:
+  // Keys for Soloud::getInfo on decode-ahead voices
+  enum INFO_KEYS {
+    // Mixer buffers that found the ring short and were padded with silence
+    INFO_STARVATIONS = 0,
+    // Frames of silence padded in
+    INFO_STARVED_SAMPLES = 1,
+    // Seconds decoded ahead of the play position
+    INFO_BUFFERED = 2
+  };
+
   int mFiletype;
   char* mFilename;
   File* mMemFile;
   File* mStreamFile;
   unsigned int mSampleCount;
+  // Decode-ahead distance in seconds, 0 to decode in the mixer
+  time mDecodeAhead;
+  // Starvations of all instances so far
+  std::atomic<unsigned int> mStarvations;
+  // MP3 seek points (drmp3_seek_point) found at load, shared by instances
+  void* mMp3SeekTable;
+  unsigned int mMp3SeekPointCount;
+  bool mMp3SeekTableEnabled;
 
   WavStream();
   virtual ~WavStream();
@@ -97,8 +198,21 @@ class WavStream : public AudioSource {
   result loadToMem(const char* aFilename);
   result loadFile(File* aFile);
   result loadFileToMem(File* aFile);
+  // Stream the entry named aName from the bank's memory; the bank must
+  // outlive this source
+  result loadBank(SoundBank* aBank, const char* aName);
+  // Decode new instances this many seconds ahead on a shared worker thread,
+  // so the codec and file reads never run in the mixer. 0 (default) decodes
+  // in the mixer.
+  void setDecodeAhead(time aSeconds);
+  // Scan MP3s for seek points on load, so seeks and loops decode from a
+  // nearby frame instead of from the start. On by default; set before
+  // loading.
+  void setMp3SeekTable(bool aEnable);
+  // Number of times instances ran dry
+  unsigned int getStarvationCount();
   virtual AudioSourceInstance* createInstance();
-  time getLength();
+  virtual time getLength();
 
  public:
   result parse(File* aFile);
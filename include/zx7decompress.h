@@ -16,7 +16,7 @@ extern "C" {
 #endif
 
 struct zx7_io {
-  unsigned char* input_data;
+  const unsigned char* input_data;
   unsigned char* output_data;
   size_t input_index;
   size_t output_index;
@@ -83,7 +83,7 @@ static void zx7_write_bytes(struct zx7_io* io, int offset, int length) {
 }
 
 static int zx7_decompress(
-  unsigned char* input_data, unsigned char* output_data) {
+  const unsigned char* input_data, unsigned char* output_data) {
   struct zx7_io io;
   int length;
 
@@ -160,11 +160,18 @@ result Ay::loadFile(File* aFile) {
   } else {
     // compressed
     int len = aFile->length() - dataofs;
-    unsigned char* buf = new unsigned char[len];
-    aFile->read(buf, len);
+    const unsigned char* mem = aFile->getMemPtr();
+    unsigned char* buf = 0;
+    if (mem) {
+      mem += dataofs;
+    } else {
+      buf = new unsigned char[len];
+      aFile->read(buf, len);
+      mem = buf;
+    }
     int bufofs = 0;
     for (int i = 0; i < kchunks; i++) {
-      bufofs += zx7_decompress(buf + bufofs, ((unsigned char*)mOps) + i * 1024);
+      bufofs += zx7_decompress(mem + bufofs, ((unsigned char*)mOps) + i * 1024);
     }
     delete[] buf;
   }
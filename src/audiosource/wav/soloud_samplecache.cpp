@@ -0,0 +1,327 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+#include "soloud_samplecache.h"
+
+#include <string.h>
+
+#include "soloud.h"
+#include "soloud_soundbank.h"
+#include "soloud_wav.h"
+
+namespace SoLoud {
+static char* copyString(const char* aString) {
+  unsigned int len = (unsigned int)strlen(aString);
+  char* s = new char[len + 1];
+  memcpy(s, aString, len + 1);
+  return s;
+}
+
+SampleCache::SampleCache() {
+  mSoloud = 0;
+  mEntries = 0;
+  mCount = 0;
+  mCapacity = 0;
+  mHead = 0;
+  mTail = 0;
+  mBudget = 0;
+  mResidentBytes = 0;
+  mResidentCount = 0;
+  mFormat = Wav::FORMAT_FLOAT;
+  mAsync = false;
+  mHits = 0;
+  mMisses = 0;
+  mEvictions = 0;
+}
+
+SampleCache::~SampleCache() {
+  for (unsigned int i = 0; i < mCount; i++) {
+    delete[] mEntries[i]->mFilename;
+    delete[] mEntries[i]->mName;
+    delete mEntries[i];
+  }
+  delete[] mEntries;
+}
+
+result SampleCache::init(Soloud* aSoloud, unsigned int aBudgetBytes,
+  bool aAsyncReload) {
+  if (!aSoloud) {
+    return INVALID_PARAMETER;
+  }
+  mSoloud = aSoloud;
+  mAsync = aAsyncReload;
+  setBudget(aBudgetBytes);
+  return SO_NO_ERROR;
+}
+
+void SampleCache::setBudget(unsigned int aBudgetBytes) {
+  mBudget = aBudgetBytes;
+  trim_internal(0);
+}
+
+unsigned int SampleCache::getBudget() {
+  return mBudget;
+}
+
+void SampleCache::setAsyncReload(bool aAsync) {
+  mAsync = aAsync;
+}
+
+result SampleCache::setSampleFormat(unsigned int aFormat) {
+  if (aFormat > Wav::FORMAT_ADPCM) {
+    return INVALID_PARAMETER;
+  }
+  mFormat = aFormat;
+  return SO_NO_ERROR;
+}
+
+static int addEntry(SampleCache* aCache, const char* aFilename,
+  SoundBank* aBank, const char* aName) {
+  if (aCache->mCount == aCache->mCapacity) {
+    unsigned int capacity = aCache->mCapacity ? aCache->mCapacity * 2 : 64;
+    SampleCache::Entry** entries = new SampleCache::Entry*[capacity];
+    if (aCache->mCount) {
+      memcpy(entries, aCache->mEntries,
+        sizeof(SampleCache::Entry*) * aCache->mCount);
+    }
+    delete[] aCache->mEntries;
+    aCache->mEntries = entries;
+    aCache->mCapacity = capacity;
+  }
+  SampleCache::Entry* e = new SampleCache::Entry;
+  e->mFilename = aFilename ? copyString(aFilename) : 0;
+  e->mBank = aBank;
+  e->mName = aName ? copyString(aName) : 0;
+  e->mBytes = 0;
+  e->mResident = false;
+  e->mResult = SO_NO_ERROR;
+  e->mPrev = 0;
+  e->mNext = 0;
+  aCache->mEntries[aCache->mCount] = e;
+  return (int)aCache->mCount++;
+}
+
+int SampleCache::add(const char* aFilename) {
+  if (!aFilename) {
+    return -1;
+  }
+  int id = find(aFilename);
+  return id >= 0 ? id : addEntry(this, aFilename, 0, 0);
+}
+
+int SampleCache::addBank(SoundBank* aBank, const char* aName) {
+  if (!aBank || !aName) {
+    return -1;
+  }
+  int id = findBank(aBank, aName);
+  return id >= 0 ? id : addEntry(this, 0, aBank, aName);
+}
+
+int SampleCache::find(const char* aFilename) {
+  if (!aFilename) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < mCount; i++) {
+    if (mEntries[i]->mFilename &&
+        strcmp(mEntries[i]->mFilename, aFilename) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int SampleCache::findBank(SoundBank* aBank, const char* aName) {
+  if (!aBank || !aName) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < mCount; i++) {
+    if (mEntries[i]->mBank == aBank && strcmp(mEntries[i]->mName, aName) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static void unlinkEntry(SampleCache* aCache, SampleCache::Entry* aEntry) {
+  if (aEntry->mPrev) {
+    aEntry->mPrev->mNext = aEntry->mNext;
+  } else {
+    aCache->mHead = aEntry->mNext;
+  }
+  if (aEntry->mNext) {
+    aEntry->mNext->mPrev = aEntry->mPrev;
+  } else {
+    aCache->mTail = aEntry->mPrev;
+  }
+  aEntry->mPrev = 0;
+  aEntry->mNext = 0;
+}
+
+static void pushEntry(SampleCache* aCache, SampleCache::Entry* aEntry) {
+  aEntry->mPrev = 0;
+  aEntry->mNext = aCache->mHead;
+  if (aCache->mHead) {
+    aCache->mHead->mPrev = aEntry;
+  } else {
+    aCache->mTail = aEntry;
+  }
+  aCache->mHead = aEntry;
+}
+
+SampleCache::Entry* SampleCache::use_internal(int aId) {
+  if (aId < 0 || (unsigned int)aId >= mCount || !mSoloud) {
+    return 0;
+  }
+  Entry* e = mEntries[aId];
+  if (e->mResident) {
+    mHits++;
+    unlinkEntry(this, e);
+    pushEntry(this, e);
+    return e;
+  }
+  mMisses++;
+  e->mWav.setSampleFormat(mFormat);
+  e->mWav.setProgressiveLoad(mAsync);
+  if (e->mFilename) {
+    e->mResult = e->mWav.load(e->mFilename);
+  } else {
+    e->mResult = e->mWav.loadBank(e->mBank, e->mName);
+  }
+  if (e->mResult != SO_NO_ERROR) {
+    return 0;
+  }
+  e->mBytes = e->mWav.getDataSize();
+  e->mResident = true;
+  mResidentBytes += e->mBytes;
+  mResidentCount++;
+  pushEntry(this, e);
+  trim_internal(e);
+  return e;
+}
+
+bool SampleCache::evict_internal(Entry* aEntry) {
+  // A virtual voice may be made real at any update, so it keeps the sound
+  // loaded like a live one.
+  if (aEntry->mWav.mVirtualVoices > 0 ||
+      mSoloud->countAudioSource(aEntry->mWav) > 0) {
+    return false;
+  }
+  // Swapping in nothing frees the samples once the empty Wav goes away, and
+  // cancels a background decode
+  Wav empty;
+  aEntry->mWav.takeData_internal(empty, mSoloud);
+  unlinkEntry(this, aEntry);
+  mResidentBytes -= aEntry->mBytes;
+  mResidentCount--;
+  aEntry->mBytes = 0;
+  aEntry->mResident = false;
+  return true;
+}
+
+void SampleCache::trim_internal(Entry* aKeep) {
+  if (mBudget == 0) {
+    return;
+  }
+  Entry* e = mTail;
+  while (e && mResidentBytes > mBudget) {
+    Entry* prev = e->mPrev;
+    if (e != aKeep && evict_internal(e)) {
+      mEvictions++;
+    }
+    e = prev;
+  }
+}
+
+handle SampleCache::play(int aId, float aVolume, float aPan, bool aPaused,
+  unsigned int aBus) {
+  Entry* e = use_internal(aId);
+  if (!e) {
+    return 0;
+  }
+  return mSoloud->play(e->mWav, aVolume, aPan, aPaused, aBus);
+}
+
+Wav* SampleCache::get(int aId) {
+  Entry* e = use_internal(aId);
+  return e ? &e->mWav : 0;
+}
+
+bool SampleCache::isResident(int aId) {
+  if (aId < 0 || (unsigned int)aId >= mCount) {
+    return false;
+  }
+  return mEntries[aId]->mResident;
+}
+
+result SampleCache::getLoadResult(int aId) {
+  if (aId < 0 || (unsigned int)aId >= mCount) {
+    return INVALID_PARAMETER;
+  }
+  return mEntries[aId]->mResult;
+}
+
+void SampleCache::trim() {
+  trim_internal(0);
+}
+
+void SampleCache::unloadAll() {
+  Entry* e = mTail;
+  while (e) {
+    Entry* prev = e->mPrev;
+    evict_internal(e);
+    e = prev;
+  }
+}
+
+unsigned int SampleCache::getResidentBytes() {
+  return mResidentBytes;
+}
+
+unsigned int SampleCache::getResidentCount() {
+  return mResidentCount;
+}
+
+unsigned int SampleCache::getCount() {
+  return mCount;
+}
+
+unsigned int SampleCache::getHitCount() {
+  return mHits;
+}
+
+unsigned int SampleCache::getMissCount() {
+  return mMisses;
+}
+
+unsigned int SampleCache::getEvictionCount() {
+  return mEvictions;
+}
+
+void SampleCache::resetStats() {
+  mHits = 0;
+  mMisses = 0;
+  mEvictions = 0;
+}
+}  // namespace SoLoud
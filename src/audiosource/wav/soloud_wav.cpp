@@ -25,25 +25,279 @@ freely, subject to the following restrictions:
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
 #include "soloud.h"
 #include "soloud_wav.h"
 #include "soloud_file.h"
+#include "soloud_soundbank.h"
+#include "soloud_thread.h"
 #include "stb_vorbis.h"
 #include "dr_mp3.h"
 #include "dr_wav.h"
 #include "dr_flac.h"
 
+#if defined(_WIN32) || defined(_WIN64)
+#include <process.h>
+#define WAV_GETPID _getpid
+#else
+#include <unistd.h>
+#define WAV_GETPID getpid
+#endif
+
+#if defined(SOLOUD_SSE_INTRINSICS) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define WAV_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace SoLoud
 {
+	static const int gAdpcmStep[89] =
+	{
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+		50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+		253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+		1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+		3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+		11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+		32767
+	};
+
+	static const int gAdpcmIndex[16] =
+	{
+		-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+	};
+
+	// Advance the IMA ADPCM predictor by one code; shared by the encoder so
+	// both sides stay in lockstep
+	static inline void adpcmStep(int aCode, int &aPredictor, int &aIndex)
+	{
+		// Same as summing step, step/2, step/4 and step/8 per set bit, but
+		// without branches
+		int diff = (gAdpcmStep[aIndex] * (2 * (aCode & 7) + 1)) >> 3;
+		aPredictor += (aCode & 8) ? -diff : diff;
+		if (aPredictor > 32767) aPredictor = 32767;
+		if (aPredictor < -32768) aPredictor = -32768;
+		aIndex += gAdpcmIndex[aCode];
+		if (aIndex < 0) aIndex = 0;
+		if (aIndex > 88) aIndex = 88;
+	}
+
+	static inline void adpcmHeader(const unsigned char *aBlock, int &aPredictor, int &aIndex)
+	{
+		aPredictor = (short)(aBlock[0] | (aBlock[1] << 8));
+		aIndex = aBlock[2] > 88 ? 88 : aBlock[2];
+	}
+
+	static unsigned int adpcmBlocks(unsigned int aSamples)
+	{
+		return (aSamples + WAV_ADPCM_BLOCK - 1) / WAV_ADPCM_BLOCK;
+	}
+
+	static unsigned long long sampleBytes(unsigned int aFormat, unsigned int aSamples, unsigned int aChannels)
+	{
+		unsigned long long frames = (unsigned long long)aSamples * aChannels;
+		switch (aFormat)
+		{
+		case Wav::FORMAT_S16: return frames * 2;
+		case Wav::FORMAT_U8: return frames;
+		case Wav::FORMAT_ADPCM: return (unsigned long long)adpcmBlocks(aSamples) * aChannels * WAV_ADPCM_BLOCK_BYTES;
+		}
+		return frames * sizeof(float);
+	}
+
+	static void s16ToFloat(const short *aSrc, float *aDst, unsigned int aCount)
+	{
+		unsigned int i = 0;
+#ifdef WAV_SSE2
+		const __m128 scale = _mm_set1_ps(1.0f / 0x8000);
+		for (; i + 8 <= aCount; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(aSrc + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(aDst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(aDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+#endif
+		for (; i < aCount; i++)
+			aDst[i] = aSrc[i] / (float)0x8000;
+	}
+
+	static void u8ToFloat(const unsigned char *aSrc, float *aDst, unsigned int aCount)
+	{
+		unsigned int i = 0;
+#ifdef WAV_SSE2
+		const __m128 scale = _mm_set1_ps(1.0f / 0x80);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i bias = _mm_set1_epi32(128);
+		for (; i + 16 <= aCount; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(aSrc + i));
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			__m128i a = _mm_sub_epi32(_mm_unpacklo_epi16(lo, zero), bias);
+			__m128i b = _mm_sub_epi32(_mm_unpackhi_epi16(lo, zero), bias);
+			__m128i c = _mm_sub_epi32(_mm_unpacklo_epi16(hi, zero), bias);
+			__m128i d = _mm_sub_epi32(_mm_unpackhi_epi16(hi, zero), bias);
+			_mm_storeu_ps(aDst + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+			_mm_storeu_ps(aDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+			_mm_storeu_ps(aDst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(c), scale));
+			_mm_storeu_ps(aDst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(d), scale));
+		}
+#endif
+		for (; i < aCount; i++)
+			aDst[i] = ((signed)aSrc[i] - 128) / (float)0x80;
+	}
+
+	static int quantize(float aSample, int aScale)
+	{
+		float v = aSample * aScale;
+		int q = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+		if (q >= aScale) q = aScale - 1;
+		if (q < -aScale) q = -aScale;
+		return q;
+	}
+
+	// Encode one channel, or a block aligned run of it starting from step
+	// index aIndex. Each block restarts the predictor from its first sample
+	// so blocks decode on their own.
+	static void adpcmEncode(const float *aSrc, unsigned int aCount, unsigned char *aDst, int &aIndex)
+	{
+		int index = aIndex;
+		unsigned int blocks = adpcmBlocks(aCount);
+		for (unsigned int b = 0; b < blocks; b++)
+		{
+			unsigned char *block = aDst + b * WAV_ADPCM_BLOCK_BYTES;
+			memset(block, 0, WAV_ADPCM_BLOCK_BYTES);
+			unsigned int start = b * WAV_ADPCM_BLOCK;
+			unsigned int n = aCount - start < WAV_ADPCM_BLOCK ? aCount - start : WAV_ADPCM_BLOCK;
+			int predictor = quantize(aSrc[start], 0x8000);
+			block[0] = (unsigned char)(predictor & 0xff);
+			block[1] = (unsigned char)((predictor >> 8) & 0xff);
+			block[2] = (unsigned char)index;
+			for (unsigned int i = 0; i < n; i++)
+			{
+				int diff = quantize(aSrc[start + i], 0x8000) - predictor;
+				int code = 0;
+				if (diff < 0)
+				{
+					code = 8;
+					diff = -diff;
+				}
+				// Nearest magnitude code for the decoder's (2 * code + 1) * step / 8
+				int step = gAdpcmStep[index];
+				int mag = (diff * 4) / step;
+				code |= mag > 7 ? 7 : mag;
+				adpcmStep(code, predictor, index);
+				block[4 + i / 2] |= (unsigned char)(code << ((i & 1) * 4));
+			}
+		}
+		aIndex = index;
+	}
+
+	// Where frame aPos of channel aChannel starts in compact data
+	static unsigned char *compactAt(unsigned int aFormat, unsigned char *aData, unsigned int aSamples, unsigned int aChannel, unsigned int aPos)
+	{
+		switch (aFormat)
+		{
+		case Wav::FORMAT_S16: return aData + ((size_t)aChannel * aSamples + aPos) * 2;
+		case Wav::FORMAT_ADPCM: return aData + ((size_t)aChannel * adpcmBlocks(aSamples) + aPos / WAV_ADPCM_BLOCK) * WAV_ADPCM_BLOCK_BYTES;
+		}
+		return aData + (size_t)aChannel * aSamples + aPos;
+	}
+
+	// Store aCount float samples of one channel in a compact format;
+	// FORMAT_ADPCM runs must start on a block
+	static void compactChannel(unsigned int aFormat, const float *aSrc, unsigned int aCount, unsigned char *aDst, int &aIndex)
+	{
+		unsigned int i;
+		switch (aFormat)
+		{
+		case Wav::FORMAT_S16:
+			for (i = 0; i < aCount; i++)
+				((short *)aDst)[i] = (short)quantize(aSrc[i], 0x8000);
+			break;
+		case Wav::FORMAT_U8:
+			for (i = 0; i < aCount; i++)
+				aDst[i] = (unsigned char)(quantize(aSrc[i], 0x80) + 128);
+			break;
+		case Wav::FORMAT_ADPCM:
+			adpcmEncode(aSrc, aCount, aDst, aIndex);
+			break;
+		}
+	}
+
+	static void adpcmDecode(const unsigned char *aSrc, unsigned int aCount, float *aDst)
+	{
+		int predictor = 0, index = 0;
+		for (unsigned int i = 0; i < aCount; i++)
+		{
+			const unsigned char *block = aSrc + (i / WAV_ADPCM_BLOCK) * WAV_ADPCM_BLOCK_BYTES;
+			unsigned int ofs = i % WAV_ADPCM_BLOCK;
+			if (ofs == 0)
+				adpcmHeader(block, predictor, index);
+			adpcmStep((block[4 + ofs / 2] >> ((ofs & 1) * 4)) & 15, predictor, index);
+			aDst[i] = predictor / (float)0x8000;
+		}
+	}
+
 	WavInstance::WavInstance(Wav *aParent)
 	{
 		mParent = aParent;
 		mOffset = 0;
+		mAdpcmOffset = ~0u;
+	}
+
+	void WavInstance::getAdpcm_internal(float *aBuffer, unsigned int aSamples, unsigned int aBufferSize)
+	{
+		unsigned int count = mParent->mSampleCount;
+		unsigned int blocks = adpcmBlocks(count);
+		unsigned int end = mOffset + aSamples;
+		unsigned int i;
+		for (i = 0; i < mChannels; i++)
+		{
+			const unsigned char *src = mParent->mCompactData + i * blocks * WAV_ADPCM_BLOCK_BYTES;
+			float *dst = aBuffer + i * aBufferSize;
+			int predictor = mAdpcmPredictor[i];
+			int index = mAdpcmIndex[i];
+			unsigned int pos = mOffset;
+			// After a seek or rewind, replay the block up to the play position
+			if (mAdpcmOffset != mOffset)
+				pos -= pos % WAV_ADPCM_BLOCK;
+			while (pos < end)
+			{
+				const unsigned char *block = src + (pos / WAV_ADPCM_BLOCK) * WAV_ADPCM_BLOCK_BYTES;
+				unsigned int ofs = pos % WAV_ADPCM_BLOCK;
+				if (ofs == 0)
+					adpcmHeader(block, predictor, index);
+				unsigned int n = WAV_ADPCM_BLOCK - ofs;
+				if (n > end - pos)
+					n = end - pos;
+				unsigned int skip = 0;
+				if (pos < mOffset)
+				{
+					skip = mOffset - pos < n ? mOffset - pos : n;
+					for (unsigned int j = 0; j < skip; j++, ofs++)
+						adpcmStep((block[4 + ofs / 2] >> ((ofs & 1) * 4)) & 15, predictor, index);
+				}
+				float *out = dst + (pos + skip - mOffset);
+				for (unsigned int j = skip; j < n; j++, ofs++)
+				{
+					adpcmStep((block[4 + ofs / 2] >> ((ofs & 1) * 4)) & 15, predictor, index);
+					*out++ = predictor * (1.0f / 0x8000);
+				}
+				pos += n;
+			}
+			mAdpcmPredictor[i] = predictor;
+			mAdpcmIndex[i] = index;
+		}
+		mAdpcmOffset = end;
 	}
 
 	unsigned int WavInstance::getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
 	{		
-		if (mParent->mData == NULL)
+		if (mParent->mData == NULL && mParent->mCompactData == NULL)
 			return 0;
 
 		unsigned int dataleft = mParent->mSampleCount - mOffset;
@@ -51,14 +305,64 @@ namespace SoLoud
 		if (copylen > aSamplesToRead)
 			copylen = aSamplesToRead;
 
+		// A progressive load may not have got this far yet; hold the play
+		// position and fill in silence until it has
+		unsigned int ready = mParent->mReadySamples.load(std::memory_order_acquire);
+		unsigned int silence = 0;
+		if (mOffset + copylen > ready)
+		{
+			unsigned int avail = ready > mOffset ? ready - mOffset : 0;
+			silence = aSamplesToRead - avail;
+			copylen = avail;
+		}
+
 		unsigned int i;
-		for (i = 0; i < mChannels; i++)
+		switch (mParent->mSampleFormat)
+		{
+		case Wav::FORMAT_S16:
+			for (i = 0; i < mChannels; i++)
+				s16ToFloat((const short *)mParent->mCompactData + mOffset + i * mParent->mSampleCount, aBuffer + i * aBufferSize, copylen);
+			break;
+		case Wav::FORMAT_U8:
+			for (i = 0; i < mChannels; i++)
+				u8ToFloat(mParent->mCompactData + mOffset + i * mParent->mSampleCount, aBuffer + i * aBufferSize, copylen);
+			break;
+		case Wav::FORMAT_ADPCM:
+			getAdpcm_internal(aBuffer, copylen, aBufferSize);
+			break;
+		default:
+			for (i = 0; i < mChannels; i++)
+			{
+				memcpy(aBuffer + i * aBufferSize, mParent->mData + mOffset + i * mParent->mSampleCount, sizeof(float) * copylen);
+			}
+		}
+
+		if (silence)
 		{
-			memcpy(aBuffer + i * aBufferSize, mParent->mData + mOffset + i * mParent->mSampleCount, sizeof(float) * copylen);
+			for (i = 0; i < mChannels; i++)
+				memset(aBuffer + i * aBufferSize + copylen, 0, sizeof(float) * silence);
 		}
 
 		mOffset += copylen;
-		return copylen;
+		return copylen + silence;
+	}
+
+	const float *WavInstance::getDirectData(unsigned int &aSamples, unsigned int &aHistory, unsigned int &aChannelStride)
+	{
+		// Still decoding goes through getAudio, which knows how to wait
+		if (mParent->mData == NULL ||
+			mParent->mReadySamples.load(std::memory_order_acquire) < mParent->mSampleCount)
+			return NULL;
+
+		aSamples = mParent->mSampleCount - mOffset;
+		aHistory = mOffset;
+		aChannelStride = mParent->mSampleCount;
+		return mParent->mData + mOffset;
+	}
+
+	void WavInstance::skipDirectData(unsigned int aSamples)
+	{
+		mOffset += aSamples;
 	}
 
 	result WavInstance::rewind()
@@ -68,6 +372,17 @@ namespace SoLoud
 		return 0;
 	}
 
+	// Samples are random access, so jump instead of decoding up to the spot
+	result WavInstance::seek(double aSeconds, float * /*aScratch*/, unsigned int /*aScratchSize*/)
+	{
+		double target = floor(aSeconds * mBaseSamplerate);
+		if (target < 0)
+			target = 0;
+		mOffset = target < mParent->mSampleCount ? (unsigned int)target : mParent->mSampleCount;
+		mStreamPosition = aSeconds;
+		return SO_NO_ERROR;
+	}
+
 	bool WavInstance::hasEnded()
 	{
 		if (!(mFlags & AudioSourceInstance::LOOPING) && mOffset >= mParent->mSampleCount)
@@ -81,221 +396,719 @@ namespace SoLoud
 	{
 		mData = NULL;
 		mSampleCount = 0;
+		mDataFile = 0;
+		mSampleFormat = FORMAT_FLOAT;
+		mCompactData = 0;
+		mReadySamples.store(0, std::memory_order_relaxed);
+		mDecodeJob = 0;
+		mProgressive = false;
 	}
 	
 	Wav::~Wav()
 	{
 		stop();
-		delete[] mData;
+		freeData_internal();
 	}
 
-#define MAKEDWORD(a,b,c,d) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a))
-
-	result Wav::loadwav(MemoryFile *aReader)
+	void Wav::freeData_internal()
 	{
-		drwav decoder;
-
-		if (!drwav_init_memory(&decoder, aReader->getMemPtr(), aReader->length(),NULL))
+		cancelDecode_internal();
+		if (mDataFile)
 		{
-			return FILE_LOAD_FAILED;
+			delete mDataFile;
 		}
-
-		drwav_uint64 samples = decoder.totalPCMFrameCount;
-
-		if (!samples)
+		else
 		{
-			drwav_uninit(&decoder);
-			return FILE_LOAD_FAILED;
+			delete[] mData;
+			delete[] mCompactData;
 		}
+		mDataFile = 0;
+		mData = 0;
+		mCompactData = 0;
+	}
 
-		mData = new float[(unsigned int)(samples * decoder.channels)];
-		mBaseSamplerate = (float)decoder.sampleRate;
-		mSampleCount = (unsigned int)samples;
-		mChannels = decoder.channels;
+	// Re-store freshly loaded float samples in mSampleFormat
+	result Wav::convert_internal()
+	{
+		if (mSampleFormat == FORMAT_FLOAT || mData == 0)
+			return SO_NO_ERROR;
+		unsigned char *data = new unsigned char[(size_t)sampleBytes(mSampleFormat, mSampleCount, mChannels)];
+		unsigned int i;
+		for (i = 0; i < mChannels; i++)
+		{
+			int index = 0;
+			compactChannel(mSampleFormat, mData + i * mSampleCount, mSampleCount, compactAt(mSampleFormat, data, mSampleCount, i, 0), index);
+		}
+		freeData_internal();
+		mCompactData = data;
+		return SO_NO_ERROR;
+	}
 
-		unsigned int i, j, k;
-		for (i = 0; i < mSampleCount; i += 512)
+	result Wav::setSampleFormat(unsigned int aFormat)
+	{
+		if (aFormat > FORMAT_ADPCM)
+			return INVALID_PARAMETER;
+		if (aFormat == mSampleFormat)
+			return SO_NO_ERROR;
+		stop();
+		finishDecode();
+		if (mCompactData)
 		{
-			float tmp[512 * MAX_CHANNELS];
-			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drwav_read_pcm_frames_f32(&decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++)
+			// Back to float first
+			float *data = new float[mSampleCount * mChannels];
+			unsigned int i;
+			for (i = 0; i < mChannels; i++)
 			{
-				for (k = 0; k < decoder.channels; k++)
+				float *dst = data + i * mSampleCount;
+				switch (mSampleFormat)
 				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder.channels + k];
+				case FORMAT_S16:
+					s16ToFloat((const short *)mCompactData + i * mSampleCount, dst, mSampleCount);
+					break;
+				case FORMAT_U8:
+					u8ToFloat(mCompactData + i * mSampleCount, dst, mSampleCount);
+					break;
+				case FORMAT_ADPCM:
+					adpcmDecode(mCompactData + i * adpcmBlocks(mSampleCount) * WAV_ADPCM_BLOCK_BYTES, mSampleCount, dst);
+					break;
 				}
 			}
+			freeData_internal();
+			mData = data;
 		}
-		drwav_uninit(&decoder);
+		mSampleFormat = aFormat;
+		return convert_internal();
+	}
 
-		return SO_NO_ERROR;
+	unsigned int Wav::getDataSize()
+	{
+		if (mData == 0 && mCompactData == 0)
+			return 0;
+		return (unsigned int)sampleBytes(mSampleFormat, mSampleCount, mChannels);
 	}
 
-	result Wav::loadogg(MemoryFile *aReader)
-	{	
-		int e = 0;
-		stb_vorbis *vorbis = 0;
-		vorbis = stb_vorbis_open_memory(aReader->getMemPtr(), aReader->length(), &e, 0);
+#define MAKEDWORD(a,b,c,d) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a))
+
+	// Pulls planar float frames out of any of the codecs Wav loads. Files
+	// with more than MAX_CHANNELS channels keep the first MAX_CHANNELS.
+	class WavDecoder
+	{
+	public:
+		unsigned int mChannels;
+		unsigned int mFrames;
+		float mSamplerate;
 
-		if (0 == vorbis)
+		WavDecoder()
 		{
-			return FILE_LOAD_FAILED;
+			mType = NONE;
+			mChannels = 0;
+			mFileChannels = 0;
+			mFrames = 0;
+			mSamplerate = 0;
+			mFlac = 0;
+			mOgg = 0;
+			mOggOutputs = 0;
+			mOggFrameSize = 0;
+			mOggOffset = 0;
+			mTmp = 0;
 		}
 
-        stb_vorbis_info info = stb_vorbis_get_info(vorbis);
-		mBaseSamplerate = (float)info.sample_rate;
-        int samples = stb_vorbis_stream_length_in_samples(vorbis);
-
-		if (info.channels > MAX_CHANNELS)
+		~WavDecoder()
 		{
-			mChannels = MAX_CHANNELS;
+			switch (mType)
+			{
+			case WAV: drwav_uninit(&mWav); break;
+			case MP3: drmp3_uninit(&mMp3); break;
+			case FLAC: drflac_close(mFlac); break;
+			case OGG: stb_vorbis_close(mOgg); break;
+			case NONE: break;
+			}
+			delete[] mTmp;
 		}
-		else
+
+		// aData must outlive the decoder
+		result open(const unsigned char *aData, unsigned int aLength, int aTag)
 		{
-			mChannels = info.channels;
+			unsigned long long frames = 0;
+			if (aTag == MAKEDWORD('O','g','g','S'))
+			{
+				int e = 0;
+				mOgg = stb_vorbis_open_memory(aData, aLength, &e, 0);
+				if (mOgg == 0)
+					return FILE_LOAD_FAILED;
+				mType = OGG;
+				stb_vorbis_info info = stb_vorbis_get_info(mOgg);
+				mFileChannels = info.channels;
+				mSamplerate = (float)info.sample_rate;
+				frames = stb_vorbis_stream_length_in_samples(mOgg);
+			}
+			else if (aTag == MAKEDWORD('R','I','F','F'))
+			{
+				if (!drwav_init_memory(&mWav, aData, aLength, NULL))
+					return FILE_LOAD_FAILED;
+				mType = WAV;
+				mFileChannels = mWav.channels;
+				mSamplerate = (float)mWav.sampleRate;
+				frames = mWav.totalPCMFrameCount;
+			}
+			else if (aTag == MAKEDWORD('f','L','a','C'))
+			{
+				mFlac = drflac_open_memory(aData, aLength, NULL);
+				if (mFlac == 0)
+					return FILE_LOAD_FAILED;
+				mType = FLAC;
+				mFileChannels = mFlac->channels;
+				mSamplerate = (float)mFlac->sampleRate;
+				frames = mFlac->totalPCMFrameCount;
+				drflac_seek_to_pcm_frame(mFlac, 0);
+			}
+			else
+			{
+				// No tag to go by; mp3 is the last resort
+				if (!drmp3_init_memory(&mMp3, aData, aLength, NULL))
+					return FILE_LOAD_FAILED;
+				mType = MP3;
+				mFileChannels = mMp3.channels;
+				mSamplerate = (float)mMp3.sampleRate;
+				frames = drmp3_get_pcm_frame_count(&mMp3);
+				drmp3_seek_to_pcm_frame(&mMp3, 0);
+			}
+			if (frames == 0 || frames > 0xffffffff || mFileChannels == 0 || !(mSamplerate > 0))
+				return FILE_LOAD_FAILED;
+			mFrames = (unsigned int)frames;
+			mChannels = mFileChannels > MAX_CHANNELS ? MAX_CHANNELS : mFileChannels;
+			if (mType != OGG)
+				mTmp = new float[512 * mFileChannels];
+			return SO_NO_ERROR;
 		}
-		mData = new float[samples * mChannels];
-		memset(mData, 0, samples * mChannels * sizeof(float));
-		mSampleCount = samples;
-		samples = 0;
-		while(1)
-		{
-			float **outputs;
-            int n = stb_vorbis_get_frame_float(vorbis, NULL, &outputs);
-			if (n == 0)
-            {
-				break;
-            }
 
+		// Decode up to aFrames frames into aDst, channel c at aDst + c * aStride.
+		// Returns fewer only at the end of the data.
+		unsigned int decode(float *aDst, unsigned int aFrames, unsigned int aStride)
+		{
+			unsigned int done = 0;
 			unsigned int ch;
-			for (ch = 0; ch < mChannels; ch++)
-				memcpy(mData + samples + mSampleCount * ch, outputs[ch], sizeof(float) * n);
+			while (done < aFrames)
+			{
+				unsigned int n;
+				if (mType == OGG)
+				{
+					if (mOggOffset >= mOggFrameSize)
+					{
+						mOggFrameSize = stb_vorbis_get_frame_float(mOgg, NULL, &mOggOutputs);
+						mOggOffset = 0;
+						if (mOggFrameSize <= 0)
+							break;
+					}
+					n = mOggFrameSize - mOggOffset;
+					if (n > aFrames - done)
+						n = aFrames - done;
+					for (ch = 0; ch < mChannels; ch++)
+						memcpy(aDst + ch * aStride + done, mOggOutputs[ch] + mOggOffset, sizeof(float) * n);
+					mOggOffset += n;
+				}
+				else
+				{
+					unsigned int want = aFrames - done > 512 ? 512 : aFrames - done;
+					switch (mType)
+					{
+					case WAV: n = (unsigned int)drwav_read_pcm_frames_f32(&mWav, want, mTmp); break;
+					case MP3: n = (unsigned int)drmp3_read_pcm_frames_f32(&mMp3, want, mTmp); break;
+					default: n = (unsigned int)drflac_read_pcm_frames_f32(mFlac, want, mTmp); break;
+					}
+					if (n == 0)
+						break;
+					unsigned int j;
+					for (j = 0; j < n; j++)
+						for (ch = 0; ch < mChannels; ch++)
+							aDst[ch * aStride + done + j] = mTmp[j * mFileChannels + ch];
+				}
+				done += n;
+			}
+			return done;
+		}
+
+	private:
+		enum { NONE, WAV, OGG, MP3, FLAC } mType;
+		unsigned int mFileChannels;
+		drwav mWav;
+		drmp3 mMp3;
+		drflac *mFlac;
+		stb_vorbis *mOgg;
+		float **mOggOutputs;
+		int mOggFrameSize;
+		int mOggOffset;
+		float *mTmp;
+	};
+
+// Frames per channel decoded at a time; a whole number of ADPCM blocks
+#define WAV_DECODE_CHUNK (WAV_ADPCM_BLOCK * 8)
+
+	struct WavDecodeJob
+	{
+		Wav *mWav;
+		WavDecoder mDecoder;
+		// Owned file or copy the encoded data lives in, when the decode
+		// outlives the load call
+		File *mSource;
+		unsigned char *mCopy;
+		// A chunk per channel, for decoding into compact formats
+		float *mScratch;
+		unsigned int mPos;
+		int mAdpcmIndex[MAX_CHANNELS];
+		bool mCached;
+		unsigned long long mKey;
+		unsigned int mLength;
+		WavDecodeJob *mNext;
+		WavDecodeJob *mPrev;
 
-			samples += n;
+		WavDecodeJob(Wav *aWav)
+		{
+			mWav = aWav;
+			mSource = 0;
+			mCopy = 0;
+			mScratch = 0;
+			mPos = 0;
+			memset(mAdpcmIndex, 0, sizeof(mAdpcmIndex));
+			mCached = false;
+			mKey = 0;
+			mLength = 0;
+			mNext = 0;
+			mPrev = 0;
 		}
-        stb_vorbis_close(vorbis);
 
-		return 0;
+		~WavDecodeJob()
+		{
+			delete[] mScratch;
+			delete[] mCopy;
+			delete mSource;
+		}
+	};
+
+	// Progressive load worker. Like the WavStream decode-ahead worker, one
+	// thread serves every load, takes a chunk from each in turn and exits
+	// once the list is empty. The mutex is held per chunk, so cancelling a
+	// load waits for at most one chunk. A finished load's cache file is
+	// written under the store mutex instead, with gLoadStoring naming the
+	// Wav whose samples are being read.
+	static WavDecodeJob *gLoadList = 0;
+	static WavDecodeJob *gLoadCursor = 0;
+	static Wav *gLoadStoring = 0;
+	static Thread::ThreadHandle gLoadThread = 0;
+	static bool gLoadRunning = false;
+
+	static void *getLoadMutex()
+	{
+		static void *mutex = Thread::createMutex();
+		return mutex;
 	}
 
-	result Wav::loadmp3(MemoryFile *aReader)
+	static void *getLoadStoreMutex()
 	{
-		drmp3 decoder;
+		static void *mutex = Thread::createMutex();
+		return mutex;
+	}
 
-		if (!drmp3_init_memory(&decoder, aReader->getMemPtr(), aReader->length(), NULL))
+	// Wait until the worker is done writing aWav's cache file
+	static void waitForStore(Wav *aWav)
+	{
+		void *mutex = getLoadMutex();
+		Thread::lockMutex(mutex);
+		bool storing = gLoadStoring == aWav;
+		Thread::unlockMutex(mutex);
+		if (storing)
 		{
-			return FILE_LOAD_FAILED;
+			void *store = getLoadStoreMutex();
+			Thread::lockMutex(store);
+			Thread::unlockMutex(store);
 		}
+	}
 
-		drmp3_uint64 samples = drmp3_get_pcm_frame_count(&decoder);
+	// Called with the load mutex held
+	static void unlinkLoad(WavDecodeJob *aJob)
+	{
+		if (gLoadCursor == aJob)
+			gLoadCursor = aJob->mNext;
+		if (aJob->mPrev)
+			aJob->mPrev->mNext = aJob->mNext;
+		else
+			gLoadList = aJob->mNext;
+		if (aJob->mNext)
+			aJob->mNext->mPrev = aJob->mPrev;
+		aJob->mNext = 0;
+		aJob->mPrev = 0;
+	}
 
-		if (!samples)
+	static void loadWorker(void * /*aParam*/)
+	{
+		void *mutex = getLoadMutex();
+		void *store = getLoadStoreMutex();
+		for (;;)
 		{
-			drmp3_uninit(&decoder);
-			return FILE_LOAD_FAILED;
+			Thread::lockMutex(mutex);
+			if (gLoadList == 0)
+			{
+				gLoadRunning = false;
+				Thread::unlockMutex(mutex);
+				return;
+			}
+			if (gLoadCursor == 0)
+				gLoadCursor = gLoadList;
+			WavDecodeJob *job = gLoadCursor;
+			gLoadCursor = job->mNext;
+			if (job->mWav->decodeChunk_internal())
+			{
+				Thread::unlockMutex(mutex);
+				continue;
+			}
+			// Done; take the job from the Wav and finish it off the mutex.
+			Wav *wav = job->mWav;
+			unlinkLoad(job);
+			wav->mDecodeJob = 0;
+			gLoadStoring = wav;
+			Thread::lockMutex(store);
+			Thread::unlockMutex(mutex);
+
+			wav->completeDecode_internal(job);
+
+			Thread::lockMutex(mutex);
+			gLoadStoring = 0;
+			Thread::unlockMutex(mutex);
+			Thread::unlockMutex(store);
 		}
+	}
 
-		mData = new float[(unsigned int)(samples * decoder.channels)];
-		mBaseSamplerate = (float)decoder.sampleRate;
-		mSampleCount = (unsigned int)samples;
-		mChannels = decoder.channels;
-		drmp3_seek_to_pcm_frame(&decoder, 0); 
+	static void addLoad(WavDecodeJob *aJob)
+	{
+		void *mutex = getLoadMutex();
+		Thread::lockMutex(mutex);
+		aJob->mPrev = 0;
+		aJob->mNext = gLoadList;
+		if (gLoadList)
+			gLoadList->mPrev = aJob;
+		gLoadList = aJob;
+		if (!gLoadRunning)
+		{
+			// The previous worker has exited (or is about to); reap it.
+			if (gLoadThread)
+			{
+				Thread::wait(gLoadThread);
+				Thread::release(gLoadThread);
+			}
+			gLoadRunning = true;
+			gLoadThread = Thread::createThread(loadWorker, 0);
+		}
+		Thread::unlockMutex(mutex);
+	}
 
-		unsigned int i, j, k;
-		for (i = 0; i<mSampleCount; i += 512)
+	bool Wav::decodeChunk_internal()
+	{
+		WavDecodeJob *job = mDecodeJob;
+		unsigned int pos = job->mPos;
+		unsigned int n = mSampleCount - pos;
+		if (n > WAV_DECODE_CHUNK)
+			n = WAV_DECODE_CHUNK;
+		unsigned int i;
+		if (mSampleFormat == FORMAT_FLOAT)
 		{
-			float tmp[512 * MAX_CHANNELS];
-			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drmp3_read_pcm_frames_f32(&decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++) 
+			unsigned int got = job->mDecoder.decode(mData + pos, n, mSampleCount);
+			// Short files read as silence past their end
+			if (got < n)
 			{
-				for (k = 0; k < decoder.channels; k++) 
-				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder.channels + k];
-				}
+				for (i = 0; i < mChannels; i++)
+					memset(mData + i * mSampleCount + pos + got, 0, sizeof(float) * (n - got));
 			}
 		}
-		drmp3_uninit(&decoder);
+		else
+		{
+			unsigned int got = job->mDecoder.decode(job->mScratch, n, WAV_DECODE_CHUNK);
+			for (i = 0; i < mChannels; i++)
+			{
+				float *src = job->mScratch + i * WAV_DECODE_CHUNK;
+				if (got < n)
+					memset(src + got, 0, sizeof(float) * (n - got));
+				compactChannel(mSampleFormat, src, n, compactAt(mSampleFormat, mCompactData, mSampleCount, i, pos), job->mAdpcmIndex[i]);
+			}
+		}
+		job->mPos = pos + n;
+		mReadySamples.store(job->mPos, std::memory_order_release);
+		return job->mPos < mSampleCount;
+	}
 
-		return SO_NO_ERROR;
+	void Wav::completeDecode_internal(WavDecodeJob *aJob)
+	{
+		mReadySamples.store(mSampleCount, std::memory_order_release);
+		if (aJob->mCached)
+			storeCache_internal(aJob->mKey, aJob->mLength);
+		delete aJob;
 	}
 
-	result Wav::loadflac(MemoryFile *aReader)
+	void Wav::cancelDecode_internal()
 	{
-		drflac *decoder = drflac_open_memory(aReader->mDataPtr, aReader->mDataLength, NULL);
+		void *mutex = getLoadMutex();
+		Thread::lockMutex(mutex);
+		if (mDecodeJob)
+		{
+			unlinkLoad(mDecodeJob);
+			delete mDecodeJob;
+			mDecodeJob = 0;
+		}
+		Thread::unlockMutex(mutex);
+		waitForStore(this);
+	}
 
-		if (!decoder)
+	void Wav::finishDecode()
+	{
+		void *mutex = getLoadMutex();
+		Thread::lockMutex(mutex);
+		WavDecodeJob *job = mDecodeJob;
+		if (job)
+			unlinkLoad(job);
+		Thread::unlockMutex(mutex);
+		// Off the list the worker can't see it, so no need to hold the mutex
+		if (job)
 		{
-			return FILE_LOAD_FAILED;
+			while (decodeChunk_internal())
+				;
+			mDecodeJob = 0;
+			completeDecode_internal(job);
 		}
+		waitForStore(this);
+	}
 
-		drflac_uint64 samples = decoder->totalPCMFrameCount;
+	void Wav::setProgressiveLoad(bool aEnable)
+	{
+		mProgressive = aEnable;
+	}
+
+	bool Wav::isDecoding()
+	{
+		return mReadySamples.load(std::memory_order_acquire) < mSampleCount;
+	}
 
-		if (!samples)
+// Bump when a decoder's output changes, so older cache files are ignored
+#define DECODE_CACHE_VERSION 1
+#define DECODE_CACHE_MAGIC MAKEDWORD('S','L','P','C')
+#define DECODE_CACHE_HEADER 64
+
+	static char gDecodeCacheDir[1024] = "";
+
+	struct DecodeCacheHeader
+	{
+		unsigned int mMagic;
+		unsigned int mVersion;
+		unsigned int mFormat; // Wav::SAMPLE_FORMAT
+		unsigned int mChannels;
+		unsigned long long mKey;
+		unsigned int mLength;
+		unsigned int mSampleCount;
+		float mSamplerate;
+		unsigned int mCheck;
+	};
+
+	// Hash of the encoded file, 8 bytes at a time
+	static unsigned long long hashContent(const unsigned char *aData, unsigned int aLength)
+	{
+		unsigned long long h = 14695981039346656037ULL ^ aLength;
+		unsigned int i = 0;
+		for (; i + 8 <= aLength; i += 8)
 		{
-			drflac_close(decoder);
-			return FILE_LOAD_FAILED;
+			unsigned long long w;
+			memcpy(&w, aData + i, 8);
+			h = (h ^ w) * 1099511628211ULL;
+			h ^= h >> 29;
 		}
+		for (; i < aLength; i++)
+			h = (h ^ aData[i]) * 1099511628211ULL;
+		return h;
+	}
+
+	static unsigned int headerCheck(const DecodeCacheHeader &aHeader)
+	{
+		unsigned int h = 2166136261u;
+		const unsigned char *p = (const unsigned char *)&aHeader;
+		for (unsigned int i = 0; i < offsetof(DecodeCacheHeader, mCheck); i++)
+			h = (h ^ p[i]) * 16777619u;
+		return h;
+	}
 
-		mData = new float[(unsigned int)(samples * decoder->channels)];
-		mBaseSamplerate = (float)decoder->sampleRate;
-		mSampleCount = (unsigned int)samples;
-		mChannels = decoder->channels;
-		drflac_seek_to_pcm_frame(decoder, 0);
+	static void cachePath(char *aDst, size_t aSize, unsigned long long aKey, unsigned int aFormat)
+	{
+		if (aFormat == Wav::FORMAT_FLOAT)
+			snprintf(aDst, aSize, "%s/%016llx.pcm", gDecodeCacheDir, aKey);
+		else
+			snprintf(aDst, aSize, "%s/%016llx.%u.pcm", gDecodeCacheDir, aKey, aFormat);
+	}
 
-		unsigned int i, j, k;
-		for (i = 0; i < mSampleCount; i += 512)
+	void Wav::setDecodeCache(const char *aDirectory)
+	{
+		if (aDirectory == 0)
 		{
-			float tmp[512 * MAX_CHANNELS];
-			unsigned int blockSize = (mSampleCount - i) > 512 ? 512 : mSampleCount - i;
-			drflac_read_pcm_frames_f32(decoder, blockSize, tmp);
-			for (j = 0; j < blockSize; j++)
-			{
-				for (k = 0; k < decoder->channels; k++)
-				{
-					mData[k * mSampleCount + i + j] = tmp[j * decoder->channels + k];
-				}
-			}
+			gDecodeCacheDir[0] = 0;
+			return;
 		}
-		drflac_close(decoder);
+		snprintf(gDecodeCacheDir, sizeof(gDecodeCacheDir), "%s", aDirectory);
+	}
 
+	result Wav::loadCache_internal(unsigned long long aKey, unsigned int aLength)
+	{
+		char path[1100];
+		cachePath(path, sizeof(path), aKey, mSampleFormat);
+		MmapFile *mf = new MmapFile;
+		if (mf->open(path) != SO_NO_ERROR || mf->length() < DECODE_CACHE_HEADER)
+		{
+			delete mf;
+			return FILE_NOT_FOUND;
+		}
+		DecodeCacheHeader h;
+		memcpy(&h, mf->getMemPtr(), sizeof(h));
+		if (h.mMagic != DECODE_CACHE_MAGIC ||
+			h.mVersion != DECODE_CACHE_VERSION ||
+			h.mFormat != mSampleFormat ||
+			h.mKey != aKey ||
+			h.mLength != aLength ||
+			h.mCheck != headerCheck(h) ||
+			h.mChannels < 1 || h.mChannels > MAX_CHANNELS ||
+			h.mSampleCount == 0 || !(h.mSamplerate > 0) ||
+			mf->length() != DECODE_CACHE_HEADER + sampleBytes(h.mFormat, h.mSampleCount, h.mChannels))
+		{
+			// Stale or corrupt, decode instead
+			delete mf;
+			return FILE_LOAD_FAILED;
+		}
+		mDataFile = mf;
+		if (mSampleFormat == FORMAT_FLOAT)
+			mData = (float*)(mf->getMemPtr() + DECODE_CACHE_HEADER);
+		else
+			mCompactData = (unsigned char*)(mf->getMemPtr() + DECODE_CACHE_HEADER);
+		mSampleCount = h.mSampleCount;
+		mChannels = h.mChannels;
+		mBaseSamplerate = h.mSamplerate;
 		return SO_NO_ERROR;
 	}
 
-    result Wav::testAndLoadFile(MemoryFile *aReader)
-    {
-		delete[] mData;
-		mData = 0;
+	void Wav::storeCache_internal(unsigned long long aKey, unsigned int aLength)
+	{
+		char path[1100], tmp[1200];
+		cachePath(path, sizeof(path), aKey, mSampleFormat);
+		// Written aside and renamed, so readers never see a partial file; the
+		// process id keeps writers in different processes apart
+		snprintf(tmp, sizeof(tmp), "%s.%d.%p.tmp", path, (int)WAV_GETPID(), (void*)this);
+		FILE *f = fopen(tmp, "wb");
+		if (!f)
+			return;
+		unsigned char header[DECODE_CACHE_HEADER];
+		memset(header, 0, sizeof(header));
+		DecodeCacheHeader h;
+		memset(&h, 0, sizeof(h));
+		h.mMagic = DECODE_CACHE_MAGIC;
+		h.mVersion = DECODE_CACHE_VERSION;
+		h.mFormat = mSampleFormat;
+		h.mChannels = mChannels;
+		h.mKey = aKey;
+		h.mLength = aLength;
+		h.mSampleCount = mSampleCount;
+		h.mSamplerate = mBaseSamplerate;
+		h.mCheck = headerCheck(h);
+		memcpy(header, &h, sizeof(h));
+		size_t bytes = getDataSize();
+		const void *data = mSampleFormat == FORMAT_FLOAT ? (const void *)mData : (const void *)mCompactData;
+		bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) &&
+			fwrite(data, 1, bytes, f) == bytes;
+		ok = fclose(f) == 0 && ok;
+		if (!ok || rename(tmp, path) != 0)
+			remove(tmp);
+	}
+
+	result Wav::testAndLoadFile(MemoryFile *aReader, File *aSource)
+	{
+		freeData_internal();
 		mSampleCount = 0;
 		mChannels = 1;
-        int tag = aReader->read32();
-		if (tag == MAKEDWORD('O','g','g','S')) 
-        {
-			return loadogg(aReader);
+		mReadySamples.store(0, std::memory_order_relaxed);
+		int tag = aReader->read32();
+		// Wav files load about as fast as the cache would
+		bool cached = gDecodeCacheDir[0] && tag != MAKEDWORD('R','I','F','F');
+		unsigned long long key = 0;
+		if (cached)
+		{
+			key = hashContent(aReader->getMemPtr(), aReader->length());
+			if (loadCache_internal(key, aReader->length()) == SO_NO_ERROR)
+			{
+				mReadySamples.store(mSampleCount, std::memory_order_release);
+				delete aSource;
+				return SO_NO_ERROR;
+			}
+		}
 
-		} 
-        else if (tag == MAKEDWORD('R','I','F','F')) 
-        {
-			return loadwav(aReader);
+		// The decoder reads the encoded data until the last chunk
+		WavDecodeJob *job = new WavDecodeJob(this);
+		const unsigned char *data = aReader->getMemPtr();
+		unsigned int length = aReader->length();
+		job->mSource = aSource;
+		if (mProgressive && aSource == 0)
+		{
+			// Outlive the caller's buffer
+			if (aReader->mDataOwned)
+			{
+				job->mCopy = (unsigned char *)aReader->mDataPtr;
+				aReader->mDataOwned = false;
+			}
+			else
+			{
+				job->mCopy = new unsigned char[length];
+				memcpy(job->mCopy, data, length);
+				data = job->mCopy;
+			}
 		}
-		else if (tag == MAKEDWORD('f', 'L', 'a', 'C'))
+		if (job->mDecoder.open(data, length, tag) != SO_NO_ERROR)
 		{
-			return loadflac(aReader);
+			delete job;
+			return FILE_LOAD_FAILED;
 		}
-		else if (loadmp3(aReader) == SO_NO_ERROR)
+
+		mChannels = job->mDecoder.mChannels;
+		mSampleCount = job->mDecoder.mFrames;
+		mBaseSamplerate = job->mDecoder.mSamplerate;
+		if (mSampleFormat == FORMAT_FLOAT)
 		{
+			mData = new float[(size_t)mSampleCount * mChannels];
+		}
+		else
+		{
+			mCompactData = new unsigned char[(size_t)sampleBytes(mSampleFormat, mSampleCount, mChannels)];
+			job->mScratch = new float[WAV_DECODE_CHUNK * mChannels];
+		}
+		job->mCached = cached;
+		job->mKey = key;
+		job->mLength = length;
+		mDecodeJob = job;
+		if (mProgressive)
+		{
+			addLoad(job);
 			return SO_NO_ERROR;
 		}
-
-		return FILE_LOAD_FAILED;
-    }
+		while (decodeChunk_internal())
+			;
+		mDecodeJob = 0;
+		completeDecode_internal(job);
+		return SO_NO_ERROR;
+	}
 
 	result Wav::load(const char *aFilename)
 	{
 		if (aFilename == 0)
 			return INVALID_PARAMETER;
 		stop();
+		// Decode straight from a mapping where we can, skipping the file copy
+		MmapFile *mf = new MmapFile;
+		if (mf->open(aFilename) == SO_NO_ERROR)
+		{
+			MemoryFile mr;
+			mr.openMem(mf->getMemPtr(), mf->length(), false, false);
+			return testAndLoadFile(&mr, mf);
+		}
+		delete mf;
 		DiskFile dr;
 		int res = dr.open(aFilename);
 		if (res == SO_NO_ERROR)
@@ -321,7 +1134,11 @@ namespace SoLoud
 		stop();
 
 		MemoryFile mr;
-		result res = mr.openFileToMem(aFile);
+		result res;
+		if (aFile->getMemPtr())
+			res = mr.openMem(aFile->getMemPtr(), aFile->length(), false, false);
+		else
+			res = mr.openFileToMem(aFile);
 
 		if (res != SO_NO_ERROR)
 		{
@@ -330,6 +1147,56 @@ namespace SoLoud
 		return testAndLoadFile(&mr);
 	}
 
+	result Wav::loadBank(SoundBank *aBank, const char *aName)
+	{
+		if (aBank == 0 || aName == 0)
+			return INVALID_PARAMETER;
+		int entry = aBank->find(aName);
+		if (entry < 0 || !aBank->getEntryData(entry))
+			return FILE_NOT_FOUND;
+		return loadMem(aBank->getEntryData(entry), aBank->getEntryLength(entry), false, false);
+	}
+
+	void Wav::takeData_internal(Wav &aFrom, Soloud *aSoloud)
+	{
+		// Settle both decodes first; the voices still playing this one hear
+		// silence past what was decoded until they are stopped below.
+		cancelDecode_internal();
+		aFrom.finishDecode();
+		Soloud *s = mSoloud ? mSoloud : aSoloud;
+		if (s)
+		{
+			s->lockAudioMutex_internal();
+			s->stopSourceVoices_internal(*this);
+		}
+		unsigned int ready = mReadySamples.load(std::memory_order_relaxed);
+		float *data = mData;
+		File *datafile = mDataFile;
+		unsigned char *compact = mCompactData;
+		unsigned int format = mSampleFormat;
+		unsigned int samples = mSampleCount;
+		unsigned int channels = mChannels;
+		float samplerate = mBaseSamplerate;
+		mData = aFrom.mData;
+		mDataFile = aFrom.mDataFile;
+		mCompactData = aFrom.mCompactData;
+		mSampleFormat = aFrom.mSampleFormat;
+		mSampleCount = aFrom.mSampleCount;
+		mChannels = aFrom.mChannels;
+		mBaseSamplerate = aFrom.mBaseSamplerate;
+		mReadySamples.store(mSampleCount, std::memory_order_release);
+		if (s)
+			s->unlockAudioMutex_internal();
+		aFrom.mData = data;
+		aFrom.mDataFile = datafile;
+		aFrom.mCompactData = compact;
+		aFrom.mSampleFormat = format;
+		aFrom.mSampleCount = samples;
+		aFrom.mChannels = channels;
+		aFrom.mBaseSamplerate = samplerate;
+		aFrom.mReadySamples.store(ready, std::memory_order_relaxed);
+	}
+
 	AudioSourceInstance *Wav::createInstance()
 	{
 		return new WavInstance(this);
@@ -347,15 +1214,20 @@ namespace SoLoud
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
 		stop();
-		delete[] mData;
-		mData = new float[aLength];	
+		freeData_internal();
 		mSampleCount = aLength / aChannels;
 		mChannels = aChannels;
 		mBaseSamplerate = aSamplerate;
-		unsigned int i;
-		for (i = 0; i < aLength; i++)
-			mData[i] = ((signed)aMem[i] - 128) / (float)0x80;
-		return SO_NO_ERROR;
+		mReadySamples.store(mSampleCount, std::memory_order_relaxed);
+		if (mSampleFormat == FORMAT_U8)
+		{
+			mCompactData = new unsigned char[aLength];
+			memcpy(mCompactData, aMem, aLength);
+			return SO_NO_ERROR;
+		}
+		mData = new float[aLength];	
+		u8ToFloat(aMem, mData, aLength);
+		return convert_internal();
 	}
 
 	result Wav::loadRawWave16(short *aMem, unsigned int aLength, float aSamplerate, unsigned int aChannels)
@@ -363,15 +1235,20 @@ namespace SoLoud
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
 		stop();
-		delete[] mData;
-		mData = new float[aLength];
+		freeData_internal();
 		mSampleCount = aLength / aChannels;
 		mChannels = aChannels;
 		mBaseSamplerate = aSamplerate;
-		unsigned int i;
-		for (i = 0; i < aLength; i++)
-			mData[i] = ((signed short)aMem[i]) / (float)0x8000;
-		return SO_NO_ERROR;
+		mReadySamples.store(mSampleCount, std::memory_order_relaxed);
+		if (mSampleFormat == FORMAT_S16)
+		{
+			mCompactData = new unsigned char[aLength * sizeof(short)];
+			memcpy(mCompactData, aMem, aLength * sizeof(short));
+			return SO_NO_ERROR;
+		}
+		mData = new float[aLength];
+		s16ToFloat(aMem, mData, aLength);
+		return convert_internal();
 	}
 
 	result Wav::loadRawWave(float *aMem, unsigned int aLength, float aSamplerate, unsigned int aChannels, bool aCopy, bool aTakeOwndership)
@@ -379,7 +1256,7 @@ namespace SoLoud
 		if (aMem == 0 || aLength == 0 || aSamplerate <= 0 || aChannels < 1)
 			return INVALID_PARAMETER;
 		stop();
-		delete[] mData;
+		freeData_internal();
 		if (aCopy == true || aTakeOwndership == false)
 		{
 			mData = new float[aLength];
@@ -392,6 +1269,7 @@ namespace SoLoud
 		mSampleCount = aLength / aChannels;
 		mChannels = aChannels;
 		mBaseSamplerate = aSamplerate;
-		return SO_NO_ERROR;
+		mReadySamples.store(mSampleCount, std::memory_order_relaxed);
+		return convert_internal();
 	}
 };
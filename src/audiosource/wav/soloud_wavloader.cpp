@@ -0,0 +1,231 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#include "soloud_wavloader.h"
+
+#include <string.h>
+
+#include "soloud.h"
+#include "soloud_file.h"
+#include "soloud_wav.h"
+
+namespace SoLoud {
+class WavLoaderTask final : public Thread::PoolTask {
+ public:
+  WavLoader* mLoader;
+
+  virtual void work() {
+    mLoader->work_internal();
+  }
+};
+
+WavLoader::WavLoader() {
+  mSoloud = 0;
+  mPool = 0;
+  mTasks = 0;
+  mThreadCount = 0;
+  mCallback = 0;
+  mUserData = 0;
+  mItems = 0;
+  mCount = 0;
+  mCapacity = 0;
+  mStarted = false;
+  mNext = 0;
+  mDone = 0;
+  mActive = 0;
+}
+
+WavLoader::~WavLoader() {
+  wait();
+  clear();
+  delete mPool;
+  for (int i = 0; i < mThreadCount; i++) {
+    delete (WavLoaderTask*)mTasks[i];
+  }
+  delete[] mTasks;
+  delete[] mItems;
+}
+
+result WavLoader::init(Soloud* aSoloud, int aThreadCount) {
+  if (aThreadCount < 0 || mPool) {
+    return INVALID_PARAMETER;
+  }
+  mSoloud = aSoloud;
+  mPool = new Thread::Pool;
+  mPool->init(aThreadCount);
+  // Without threads one task does the whole batch inline
+  mThreadCount = aThreadCount ? aThreadCount : 1;
+  mTasks = new Thread::PoolTask*[mThreadCount];
+  for (int i = 0; i < mThreadCount; i++) {
+    WavLoaderTask* task = new WavLoaderTask;
+    task->mLoader = this;
+    mTasks[i] = task;
+  }
+  return SO_NO_ERROR;
+}
+
+void WavLoader::setCallback(loadCallback aCallback, void* aUserData) {
+  mCallback = aCallback;
+  mUserData = aUserData;
+}
+
+static result addItem(WavLoader* aLoader, Wav* aWav, const char* aFilename,
+  File* aFile) {
+  if (!aWav || (!aFilename && !aFile)) {
+    return INVALID_PARAMETER;
+  }
+  if (aLoader->mStarted) {
+    return INVALID_PARAMETER;
+  }
+  if (aLoader->mCount == aLoader->mCapacity) {
+    unsigned int capacity = aLoader->mCapacity ? aLoader->mCapacity * 2 : 64;
+    WavLoader::Item* items = new WavLoader::Item[capacity];
+    if (aLoader->mCount) {
+      memcpy(items, aLoader->mItems, sizeof(WavLoader::Item) * aLoader->mCount);
+    }
+    delete[] aLoader->mItems;
+    aLoader->mItems = items;
+    aLoader->mCapacity = capacity;
+  }
+  WavLoader::Item& item = aLoader->mItems[aLoader->mCount];
+  item.mWav = aWav;
+  item.mFilename = 0;
+  if (aFilename) {
+    unsigned int len = (unsigned int)strlen(aFilename);
+    item.mFilename = new char[len + 1];
+    memcpy(item.mFilename, aFilename, len + 1);
+  }
+  item.mFile = aFile;
+  item.mResult = UNKNOWN_ERROR;
+  aLoader->mCount++;
+  return SO_NO_ERROR;
+}
+
+result WavLoader::add(Wav* aWav, const char* aFilename) {
+  if (!aFilename) {
+    return INVALID_PARAMETER;
+  }
+  return addItem(this, aWav, aFilename, 0);
+}
+
+result WavLoader::add(Wav* aWav, File* aFile) {
+  if (!aFile) {
+    return INVALID_PARAMETER;
+  }
+  return addItem(this, aWav, 0, aFile);
+}
+
+result WavLoader::start() {
+  if (!mPool || mStarted) {
+    return INVALID_PARAMETER;
+  }
+  mStarted = true;
+  mNext = 0;
+  mDone = 0;
+  int tasks = mThreadCount;
+  if ((unsigned int)tasks > mCount) {
+    tasks = mCount ? (int)mCount : 1;
+  }
+  mActive = tasks;
+  for (int i = 0; i < tasks; i++) {
+    mPool->addWork(mTasks[i]);
+  }
+  return SO_NO_ERROR;
+}
+
+void WavLoader::work_internal() {
+  for (;;) {
+    unsigned int i = mNext.fetch_add(1);
+    if (i >= mCount) {
+      break;
+    }
+    Item& item = mItems[i];
+    // Decode aside, then publish in one step
+    Wav loaded;
+    loaded.setSampleFormat(item.mWav->mSampleFormat);
+    if (item.mFilename) {
+      item.mResult = loaded.load(item.mFilename);
+    } else {
+      item.mResult = loaded.loadFile(item.mFile);
+    }
+    if (item.mResult == SO_NO_ERROR) {
+      item.mWav->takeData_internal(loaded, mSoloud);
+    }
+    unsigned int done = mDone.fetch_add(1) + 1;
+    if (mCallback) {
+      mCallback(item.mWav, item.mResult, done, mCount, mUserData);
+    }
+  }
+  // Last touch of the loader; wait() may return and free it after this
+  mActive.fetch_sub(1);
+}
+
+bool WavLoader::isDone() {
+  return !mStarted || mActive.load() == 0;
+}
+
+unsigned int WavLoader::getDoneCount() {
+  return mDone.load();
+}
+
+unsigned int WavLoader::getCount() {
+  return mCount;
+}
+
+result WavLoader::wait() {
+  if (!mStarted) {
+    return SO_NO_ERROR;
+  }
+  while (mActive.load() != 0) {
+    Thread::sleep(1);
+  }
+  for (unsigned int i = 0; i < mCount; i++) {
+    if (mItems[i].mResult != SO_NO_ERROR) {
+      return mItems[i].mResult;
+    }
+  }
+  return SO_NO_ERROR;
+}
+
+result WavLoader::getResult(unsigned int aIndex) {
+  if (aIndex >= mCount) {
+    return INVALID_PARAMETER;
+  }
+  if (!mStarted || !isDone()) {
+    return UNKNOWN_ERROR;
+  }
+  return mItems[aIndex].mResult;
+}
+
+void WavLoader::clear() {
+  wait();
+  for (unsigned int i = 0; i < mCount; i++) {
+    delete[] mItems[i].mFilename;
+  }
+  mCount = 0;
+  mStarted = false;
+  mNext = 0;
+  mDone = 0;
+}
+}  // namespace SoLoud
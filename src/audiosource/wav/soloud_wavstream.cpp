@@ -31,6 +31,8 @@ freely, subject to the following restrictions:
 #include "dr_wav.h"
 #include "soloud_wavstream.h"
 #include "soloud_file.h"
+#include "soloud_soundbank.h"
+#include "soloud_thread.h"
 #include "stb_vorbis.h"
 
 namespace SoLoud
@@ -80,14 +82,165 @@ namespace SoLoud
 		return 1;
 	}
 
-	WavStreamInstance::WavStreamInstance(WavStream *aParent)
+	// Decode-ahead worker. One thread serves every decode-ahead decoder; it
+	// exits when the last one goes away and is restarted on demand. The
+	// list mutex is only held to pick the next decoder; the chunk is then
+	// decoded under the work mutex. An instance destroyed while its decoder
+	// is being worked on leaves the decoder to the worker to free, so the
+	// mixer never waits on a chunk.
+	static WavStreamDecoder *gDecodeList = 0;
+	static WavStreamDecoder *gDecodeCursor = 0;
+	static WavStreamDecoder *gDecodeCurrent = 0;
+	static Thread::ThreadHandle gDecodeThread = 0;
+	static bool gDecodeRunning = false;
+
+	static void *getDecodeMutex()
+	{
+		static void *mutex = Thread::createMutex();
+		return mutex;
+	}
+
+	static void *getDecodeWorkMutex()
+	{
+		static void *mutex = Thread::createMutex();
+		return mutex;
+	}
+
+	static void decodeAheadWorker(void * /*aParam*/)
+	{
+		float scratch[DECODE_AHEAD_CHUNK * MAX_CHANNELS];
+		void *mutex = getDecodeMutex();
+		void *work = getDecodeWorkMutex();
+		bool busy = false;
+		for (;;)
+		{
+			Thread::lockMutex(work);
+			Thread::lockMutex(mutex);
+			if (gDecodeList == 0)
+			{
+				gDecodeRunning = false;
+				Thread::unlockMutex(mutex);
+				Thread::unlockMutex(work);
+				return;
+			}
+			WavStreamDecoder *d = gDecodeCursor ? gDecodeCursor : gDecodeList;
+			gDecodeCursor = d->mDecodeNext;
+			gDecodeCurrent = d;
+			Thread::unlockMutex(mutex);
+
+			if (d->fillRing_internal(scratch, true))
+				busy = true;
+
+			Thread::lockMutex(mutex);
+			gDecodeCurrent = 0;
+			bool dead = d->mDead;
+			bool wrapped = gDecodeCursor == 0;
+			Thread::unlockMutex(mutex);
+			// Still under the work mutex, so waitForDecodeAhead sees it gone
+			if (dead)
+				delete d;
+			Thread::unlockMutex(work);
+			if (wrapped)
+			{
+				// Every decoder had its turn; rest if none had anything to do.
+				if (!busy)
+					Thread::sleep(2);
+				busy = false;
+			}
+		}
+	}
+
+	static void addDecodeAhead(WavStreamDecoder *aDecoder)
+	{
+		void *mutex = getDecodeMutex();
+		Thread::lockMutex(mutex);
+		aDecoder->mDecodePrev = 0;
+		aDecoder->mDecodeNext = gDecodeList;
+		if (gDecodeList)
+			gDecodeList->mDecodePrev = aDecoder;
+		gDecodeList = aDecoder;
+		if (!gDecodeRunning)
+		{
+			// The previous worker has exited (or is about to); reap it.
+			if (gDecodeThread)
+			{
+				Thread::wait(gDecodeThread);
+				Thread::release(gDecodeThread);
+			}
+			gDecodeRunning = true;
+			gDecodeThread = Thread::createThread(decodeAheadWorker, 0);
+		}
+		Thread::unlockMutex(mutex);
+	}
+
+	// Unlink the decoder. Returns false if the worker is decoding it; it is
+	// then marked dead and the worker frees it once the chunk is done.
+	static bool removeDecodeAhead(WavStreamDecoder *aDecoder)
+	{
+		void *mutex = getDecodeMutex();
+		Thread::lockMutex(mutex);
+		if (aDecoder->mDecodePrev)
+			aDecoder->mDecodePrev->mDecodeNext = aDecoder->mDecodeNext;
+		else
+			gDecodeList = aDecoder->mDecodeNext;
+		if (aDecoder->mDecodeNext)
+			aDecoder->mDecodeNext->mDecodePrev = aDecoder->mDecodePrev;
+		if (gDecodeCursor == aDecoder)
+			gDecodeCursor = aDecoder->mDecodeNext;
+		bool pinned = gDecodeCurrent == aDecoder;
+		if (pinned)
+			aDecoder->mDead = true;
+		Thread::unlockMutex(mutex);
+		return !pinned;
+	}
+
+	// Wait until no dead decoder of aParent is left with the worker; it may
+	// still read the parent's memory file, stream file or MP3 seek table.
+	static void waitForDecodeAhead(WavStream *aParent)
+	{
+		void *mutex = getDecodeMutex();
+		Thread::lockMutex(mutex);
+		bool busy = gDecodeCurrent && gDecodeCurrent->mDead && gDecodeCurrent->mParent == aParent;
+		Thread::unlockMutex(mutex);
+		if (busy)
+		{
+			void *work = getDecodeWorkMutex();
+			Thread::lockMutex(work);
+			Thread::unlockMutex(work);
+		}
+	}
+
+	WavStreamDecoder::WavStreamDecoder(WavStream *aParent)
 	{
-		mOggFrameSize = 0;
 		mParent = aParent;
+		mFiletype = aParent->mFiletype;
+		mSampleCount = aParent->mSampleCount;
+		mBaseSamplerate = aParent->mBaseSamplerate;
+		mChannels = aParent->mChannels;
+		mOggFrameSize = 0;
 		mOffset = 0;
 		mCodec.mOgg = 0;
 		mCodec.mFlac = 0;
 		mFile = 0;
+		mSharedFile = false;
+		mRing = 0;
+		mRingFrames = 0;
+		mRingWrite = 0;
+		mRingRead = 0;
+		mRingEnd = 0;
+		mRingEnded = false;
+		mRingLoopMark = 0;
+		mRingLoopPending = false;
+		mRingLooping = (aParent->mFlags & AudioSource::SHOULD_LOOP) != 0;
+		mRingLoopPoint = aParent->mLoopPoint;
+		mSeekTarget = 0;
+		mSeekLanded = 0;
+		mSeekSerial = 0;
+		mSeekAck = 0;
+		mRingSeekStart = 0;
+		mDecodeNext = 0;
+		mDecodePrev = 0;
+		mDead = false;
 		if (aParent->mMemFile)
 		{
 			MemoryFile *mf = new MemoryFile();
@@ -102,9 +255,18 @@ namespace SoLoud
 			df->open(aParent->mFilename);
 		}
 		else
+		if (aParent->mStreamFile && aParent->mStreamFile->getMemPtr())
+		{
+			// Memory-backed (e.g. mapped) files get a cursor per instance
+			MemoryFile *mf = new MemoryFile();
+			mFile = mf;
+			mf->openMem(aParent->mStreamFile->getMemPtr(), aParent->mStreamFile->length(), false, false);
+		}
+		else
 		if (aParent->mStreamFile)
 		{
 			mFile = aParent->mStreamFile;
+			mSharedFile = true;
 			mFile->seek(0); // stb_vorbis assumes file offset to be at start of ogg
 		}
 		else
@@ -114,20 +276,20 @@ namespace SoLoud
 		
 		if (mFile)
 		{
-			if (mParent->mFiletype == WAVSTREAM_WAV)
+			if (mFiletype == WAVSTREAM_WAV)
 			{
 				mCodec.mWav = new drwav;
 				if (!drwav_init(mCodec.mWav, drwav_read_func, drwav_seek_func, (void*)mFile, NULL))
 				{
 					delete mCodec.mWav;
 					mCodec.mWav = 0;
-					if (mFile != mParent->mStreamFile)
+					if (!mSharedFile)
 						delete mFile;
 					mFile = 0;
 				}
 			}
 			else
-			if (mParent->mFiletype == WAVSTREAM_OGG)
+			if (mFiletype == WAVSTREAM_OGG)
 			{
 				int e;
 
@@ -135,7 +297,7 @@ namespace SoLoud
 
 				if (!mCodec.mOgg)
 				{
-					if (mFile != mParent->mStreamFile)
+					if (!mSharedFile)
 						delete mFile;
 					mFile = 0;
 				}
@@ -144,42 +306,65 @@ namespace SoLoud
 				mOggOutputs = 0;
 			}
 			else
-			if (mParent->mFiletype == WAVSTREAM_FLAC)
+			if (mFiletype == WAVSTREAM_FLAC)
 			{
 				mCodec.mFlac = drflac_open(drflac_read_func, drflac_seek_func, (void*)mFile, NULL);
 				if (!mCodec.mFlac)
 				{
-					if (mFile != mParent->mStreamFile)
+					if (!mSharedFile)
 						delete mFile;
 					mFile = 0;
 				}
 			}
 			else
-			if (mParent->mFiletype == WAVSTREAM_MP3)
+			if (mFiletype == WAVSTREAM_MP3)
 			{
 				mCodec.mMp3 = new drmp3;
 				if (!drmp3_init(mCodec.mMp3, drmp3_read_func, drmp3_seek_func, (void*)mFile, NULL))
 				{
 					delete mCodec.mMp3;
 					mCodec.mMp3 = 0;
-					if (mFile != mParent->mStreamFile)
+					if (!mSharedFile)
 						delete mFile;
 					mFile = 0;
 				}
+				else if (mParent->mMp3SeekTable)
+				{
+					drmp3_bind_seek_table(mCodec.mMp3, mParent->mMp3SeekPointCount, (drmp3_seek_point *)mParent->mMp3SeekTable);
+				}
 			}
 			else
 			{
-				if (mFile != mParent->mStreamFile)
+				if (!mSharedFile)
 					delete mFile;
 				mFile = NULL;
 				return;
 			}
 		}
+
+		if (mFile && mParent->mDecodeAhead > 0)
+		{
+			unsigned int frames = (unsigned int)ceil(mParent->mDecodeAhead * mBaseSamplerate);
+			mRingFrames = DECODE_AHEAD_CHUNK * 2;
+			while (mRingFrames < frames)
+				mRingFrames *= 2;
+			mRing = new float[mRingFrames * mChannels];
+
+			// Prime the ring here, outside the mixer, so playback doesn't
+			// start out starved. The end of the stream is left for the
+			// worker, which knows whether the voice loops.
+			float scratch[DECODE_AHEAD_CHUNK * MAX_CHANNELS];
+			while (fillRing_internal(scratch, false))
+			{
+			}
+			addDecodeAhead(this);
+		}
 	}
 
-	WavStreamInstance::~WavStreamInstance()
+	WavStreamDecoder::~WavStreamDecoder()
 	{
-		switch (mParent->mFiletype)
+		delete[] mRing;
+		switch (mFiletype)
 		{
 		case WAVSTREAM_OGG:
 			if (mCodec.mOgg)
@@ -210,12 +395,29 @@ namespace SoLoud
 			}
 			break;
 		}
-		if (mFile != mParent->mStreamFile)
+		if (!mSharedFile)
 		{
 			delete mFile;
 		}
 	}
 
+	WavStreamInstance::WavStreamInstance(WavStream *aParent)
+	{
+		mParent = aParent;
+		mSeekSeen = 0;
+		mSeekHeld = 0;
+		mStarvations = 0;
+		mStarvedSamples = 0;
+		mDecoder = new WavStreamDecoder(aParent);
+	}
+
+	WavStreamInstance::~WavStreamInstance()
+	{
+		// A decoder the worker is busy with is freed by the worker
+		if (!mDecoder->mRing || removeDecodeAhead(mDecoder))
+			delete mDecoder;
+	}
+
 	static int getOggData(float **aOggOutputs, float *aBuffer, int aSamples, int aPitch, int aFrameSize, int aFrameOffset, int aChannels)
 	{			
 		if (aFrameSize <= 0)
@@ -237,13 +439,13 @@ namespace SoLoud
 
 	
 
-	unsigned int WavStreamInstance::getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
+	unsigned int WavStreamDecoder::decode_internal(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
 	{			
 		unsigned int offset = 0;
 		float tmp[512 * MAX_CHANNELS];
 		if (mFile == NULL)
 			return 0;
-		switch (mParent->mFiletype)
+		switch (mFiletype)
 		{
 		case WAVSTREAM_FLAC:
 			{
@@ -258,7 +460,7 @@ namespace SoLoud
 					{
 						for (k = 0; k < mChannels; k++)
 						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mFlac->channels + k];
+							aBuffer[k * aBufferSize + i + j] = tmp[j * mCodec.mFlac->channels + k];
 						}
 					}
 				}
@@ -279,7 +481,7 @@ namespace SoLoud
 					{
 						for (k = 0; k < mChannels; k++)
 						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mMp3->channels + k];
+							aBuffer[k * aBufferSize + i + j] = tmp[j * mCodec.mMp3->channels + k];
 						}
 					}
 				}
@@ -306,7 +508,7 @@ namespace SoLoud
 					offset += b;
 					mOggFrameOffset += b;
 
-					if (mOffset >= mParent->mSampleCount || b == 0)
+					if (mOffset >= mSampleCount || b == 0)
 					{
 						mOffset += offset;
 						return offset;
@@ -327,7 +529,7 @@ namespace SoLoud
 					{
 						for (k = 0; k < mChannels; k++)
 						{
-							aBuffer[k * aSamplesToRead + i + j] = tmp[j * mCodec.mWav->channels + k];
+							aBuffer[k * aBufferSize + i + j] = tmp[j * mCodec.mWav->channels + k];
 						}
 					}
 				}
@@ -339,28 +541,261 @@ namespace SoLoud
 		return aSamplesToRead;
 	}
 
+	unsigned int WavStreamInstance::getAudio(float *aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize)
+	{
+		if (mDecoder->mRing)
+			return getRingAudio_internal(aBuffer, aSamplesToRead, aBufferSize);
+		return mDecoder->decode_internal(aBuffer, aSamplesToRead, aBufferSize);
+	}
+
+	unsigned int WavStreamInstance::getRingAudio_internal(float *aBuffer, unsigned int aSamples, unsigned int aBufferSize)
+	{
+		WavStreamDecoder *d = mDecoder;
+		unsigned int k;
+		d->mRingLooping.store((mFlags & AudioSourceInstance::LOOPING) != 0, std::memory_order_relaxed);
+		d->mRingLoopPoint.store(mLoopPoint, std::memory_order_relaxed);
+
+		unsigned int serial = d->mSeekSerial.load(std::memory_order_relaxed);
+		if (d->mSeekAck.load(std::memory_order_acquire) != serial)
+		{
+			// Seek still in flight; hold silent.
+			for (k = 0; k < mChannels; k++)
+				memset(aBuffer + k * aBufferSize, 0, sizeof(float) * aSamples);
+			mSeekHeld += aSamples / mBaseSamplerate;
+			return aSamples;
+		}
+		unsigned int r = d->mRingRead.load(std::memory_order_relaxed);
+		if (mSeekSeen != serial)
+		{
+			// The codec may not land exactly where asked
+			r = d->mRingSeekStart.load(std::memory_order_relaxed);
+			// The engine kept counting play time while we held silent; take
+			// it back off so the position starts where the seek landed.
+			mStreamPosition = d->mSeekLanded.load(std::memory_order_relaxed) - mSeekHeld;
+			mSeekHeld = 0;
+			mSeekSeen = serial;
+		}
+
+		unsigned int avail = d->mRingWrite.load(std::memory_order_acquire) - r;
+		bool stop = false;
+		if (d->mRingLoopPending.load(std::memory_order_acquire))
+		{
+			unsigned int m = d->mRingLoopMark.load(std::memory_order_relaxed) - r;
+			if (m <= avail)
+			{
+				avail = m;
+				stop = true;
+			}
+		}
+		if (d->mRingEnded.load(std::memory_order_acquire))
+		{
+			unsigned int e = d->mRingEnd.load(std::memory_order_relaxed) - r;
+			if (e <= avail)
+			{
+				avail = e;
+				stop = true;
+			}
+		}
+
+		unsigned int copy = avail < aSamples ? avail : aSamples;
+		unsigned int start = r & (d->mRingFrames - 1);
+		unsigned int first = d->mRingFrames - start;
+		if (first > copy)
+			first = copy;
+		for (k = 0; k < mChannels; k++)
+		{
+			float *src = d->mRing + k * d->mRingFrames;
+			memcpy(aBuffer + k * aBufferSize, src + start, sizeof(float) * first);
+			memcpy(aBuffer + k * aBufferSize + first, src, sizeof(float) * (copy - first));
+		}
+		d->mRingRead.store(r + copy, std::memory_order_release);
+
+		if (copy < aSamples && !stop)
+		{
+			// The worker fell behind: pad with silence rather than wait.
+			for (k = 0; k < mChannels; k++)
+				memset(aBuffer + k * aBufferSize + copy, 0, sizeof(float) * (aSamples - copy));
+			mStarvations++;
+			mStarvedSamples += aSamples - copy;
+			mParent->mStarvations.fetch_add(1, std::memory_order_relaxed);
+			return aSamples;
+		}
+		return copy;
+	}
+
+	bool WavStreamDecoder::fillRing_internal(float *aScratch, bool aHandleEnd)
+	{
+		unsigned int serial = mSeekSerial.load(std::memory_order_acquire);
+		if (serial != mSeekAck.load(std::memory_order_relaxed))
+		{
+			seekCodec_internal(mSeekTarget.load(std::memory_order_relaxed), aScratch, DECODE_AHEAD_CHUNK);
+			mRingEnded.store(false, std::memory_order_relaxed);
+			mRingLoopPending.store(false, std::memory_order_relaxed);
+			mRingSeekStart.store(mRingWrite.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			mSeekLanded.store(mOffset / mBaseSamplerate, std::memory_order_relaxed);
+			mSeekAck.store(serial, std::memory_order_release);
+			return true;
+		}
+		if (mRingEnded.load(std::memory_order_relaxed))
+			return false;
+
+		// Frames before the last seek start are dead even if the mixer
+		// hasn't skipped past them yet.
+		unsigned int w = mRingWrite.load(std::memory_order_relaxed);
+		unsigned int r = mRingRead.load(std::memory_order_acquire);
+		unsigned int seekstart = mRingSeekStart.load(std::memory_order_relaxed);
+		if ((int)(r - seekstart) < 0)
+			r = seekstart;
+		if (mRingFrames - (w - r) < DECODE_AHEAD_CHUNK)
+			return false;
+
+		unsigned int n = decode_internal(aScratch, DECODE_AHEAD_CHUNK, DECODE_AHEAD_CHUNK);
+		if (mSeekSerial.load(std::memory_order_acquire) != serial)
+		{
+			// Decoded from before a seek; drop it and seek on the next pass.
+			return true;
+		}
+
+		unsigned int k;
+		unsigned int start = w & (mRingFrames - 1);
+		unsigned int first = mRingFrames - start;
+		if (first > n)
+			first = n;
+		for (k = 0; k < mChannels; k++)
+		{
+			float *dst = mRing + k * mRingFrames;
+			memcpy(dst + start, aScratch + k * DECODE_AHEAD_CHUNK, sizeof(float) * first);
+			memcpy(dst, aScratch + k * DECODE_AHEAD_CHUNK + first, sizeof(float) * (n - first));
+		}
+		w += n;
+		mRingWrite.store(w, std::memory_order_release);
+
+		if (n < DECODE_AHEAD_CHUNK && aHandleEnd)
+		{
+			if (!mRingLooping.load(std::memory_order_relaxed))
+			{
+				mRingEnd.store(w, std::memory_order_relaxed);
+				mRingEnded.store(true, std::memory_order_release);
+			}
+			else
+			if (!mRingLoopPending.load(std::memory_order_acquire))
+			{
+				// Carry on from the loop point. Only one loop may be pending,
+				// so short loops are buffered a loop at a time.
+				mRingLoopMark.store(w, std::memory_order_relaxed);
+				mRingLoopPending.store(true, std::memory_order_release);
+				seekCodec_internal(mRingLoopPoint.load(std::memory_order_relaxed), aScratch, DECODE_AHEAD_CHUNK);
+				return true;
+			}
+		}
+		return n > 0;
+	}
+
+	bool WavStreamDecoder::seekNative_internal(unsigned int aFrame)
+	{
+		if (aFrame > mSampleCount)
+			aFrame = mSampleCount;
+		bool ok = false;
+		switch (mFiletype)
+		{
+		case WAVSTREAM_FLAC:
+			ok = mCodec.mFlac && drflac_seek_to_pcm_frame(mCodec.mFlac, aFrame);
+			break;
+		case WAVSTREAM_MP3:
+			ok = mCodec.mMp3 && drmp3_seek_to_pcm_frame(mCodec.mMp3, aFrame);
+			break;
+		case WAVSTREAM_WAV:
+			ok = mCodec.mWav && drwav_seek_to_pcm_frame(mCodec.mWav, aFrame);
+			break;
+		}
+		if (ok)
+			mOffset = aFrame;
+		return ok;
+	}
+
+	void WavStreamDecoder::seekCodec_internal(double aSeconds, float *aScratch, unsigned int aScratchFrames)
+	{
+		unsigned int target = (unsigned int)floor(mBaseSamplerate * aSeconds);
+		if (mFiletype == WAVSTREAM_OGG && mCodec.mOgg)
+		{
+			stb_vorbis_seek(mCodec.mOgg, target);
+			mOffset = stb_vorbis_get_sample_offset(mCodec.mOgg);
+			mOggFrameSize = 0;
+			mOggFrameOffset = 0;
+			return;
+		}
+		if (seekNative_internal(target))
+			return;
+		// The codec refused; start over and decode up to the target
+		rewindCodec_internal();
+		while (mOffset < target)
+		{
+			unsigned int frames = target - mOffset;
+			if (frames > aScratchFrames)
+				frames = aScratchFrames;
+			if (decode_internal(aScratch, frames, aScratchFrames) == 0)
+				break;
+		}
+	}
+
 	result WavStreamInstance::seek(double aSeconds, float* mScratch, unsigned int mScratchSize)
 	{
-		if (mCodec.mOgg)
+		WavStreamDecoder *d = mDecoder;
+		if (d->mRing)
+		{
+			unsigned int serial = d->mSeekSerial.load(std::memory_order_relaxed);
+			if (d->mSeekAck.load(std::memory_order_acquire) == serial && mSeekSeen == serial &&
+				d->mRingLoopPending.load(std::memory_order_acquire) &&
+				d->mRingLoopMark.load(std::memory_order_relaxed) == d->mRingRead.load(std::memory_order_relaxed) &&
+				aSeconds == d->mRingLoopPoint.load(std::memory_order_relaxed))
+			{
+				// The mixer wrapping a loop the worker has already wrapped
+				d->mRingLoopPending.store(false, std::memory_order_release);
+			}
+			else
+			{
+				d->mSeekTarget.store(aSeconds, std::memory_order_relaxed);
+				d->mSeekSerial.store(serial + 1, std::memory_order_release);
+			}
+			mStreamPosition = aSeconds;
+			mSeekHeld = 0;
+			return SO_NO_ERROR;
+		}
+		if (d->mFiletype == WAVSTREAM_OGG && d->mCodec.mOgg)
 		{
 			int pos = (int)floor(mBaseSamplerate * aSeconds);
-			stb_vorbis_seek(mCodec.mOgg, pos);
+			stb_vorbis_seek(d->mCodec.mOgg, pos);
 			// Since the position that we just sought to might not be *exactly*
 			// the position we asked for, we're re-calculating the position just
 			// for the sake of correctness.
-			mOffset = stb_vorbis_get_sample_offset(mCodec.mOgg);
-			double newPosition = float(mOffset / mBaseSamplerate);
+			d->mOffset = stb_vorbis_get_sample_offset(d->mCodec.mOgg);
+			// Drop what was left of the frame decoded before the seek
+			d->mOggFrameSize = 0;
+			d->mOggFrameOffset = 0;
+			double newPosition = float(d->mOffset / mBaseSamplerate);
 			mStreamPosition = newPosition;
 			return 0;
 		}
-		else {
-			return AudioSourceInstance::seek(aSeconds, mScratch, mScratchSize);
+		if (d->seekNative_internal((unsigned int)floor(mBaseSamplerate * aSeconds)))
+		{
+			mStreamPosition = aSeconds;
+			return 0;
 		}
+		return AudioSourceInstance::seek(aSeconds, mScratch, mScratchSize);
 	}
 
 	result WavStreamInstance::rewind()
 	{
-		switch (mParent->mFiletype)
+		if (mDecoder->mRing)
+			return seek(0, 0, 0);
+		mDecoder->rewindCodec_internal();
+		mStreamPosition = 0.0f;
+		return 0;
+	}
+
+	void WavStreamDecoder::rewindCodec_internal()
+	{
+		switch (mFiletype)
 		{
 		case WAVSTREAM_OGG:
 			if (mCodec.mOgg)
@@ -388,19 +823,52 @@ namespace SoLoud
 			break;
 		}
 		mOffset = 0;
-		mStreamPosition = 0.0f;
-		return 0;
+		mOggFrameSize = 0;
+		mOggFrameOffset = 0;
 	}
 
 	bool WavStreamInstance::hasEnded()
 	{
-		if (mOffset >= mParent->mSampleCount)
+		WavStreamDecoder *d = mDecoder;
+		if (d->mRing)
+		{
+			if (d->mSeekAck.load(std::memory_order_acquire) != d->mSeekSerial.load(std::memory_order_relaxed))
+				return 0;
+			unsigned int r = d->mRingRead.load(std::memory_order_relaxed);
+			if (d->mRingEnded.load(std::memory_order_acquire) &&
+				(int)(r - d->mRingEnd.load(std::memory_order_relaxed)) >= 0)
+				return 1;
+			// Looping was turned off after the worker had already looped
+			if (!(mFlags & AudioSourceInstance::LOOPING) &&
+				d->mRingLoopPending.load(std::memory_order_acquire) &&
+				d->mRingLoopMark.load(std::memory_order_relaxed) == r)
+				return 1;
+			return 0;
+		}
+		if (d->mOffset >= d->mSampleCount)
 		{
 			return 1;
 		}
 		return 0;
 	}
 
+	float WavStreamInstance::getInfo(unsigned int aInfoKey)
+	{
+		WavStreamDecoder *d = mDecoder;
+		switch (aInfoKey)
+		{
+		case WavStream::INFO_STARVATIONS:
+			return (float)mStarvations;
+		case WavStream::INFO_STARVED_SAMPLES:
+			return (float)mStarvedSamples;
+		case WavStream::INFO_BUFFERED:
+			if (d->mRing && mBaseSamplerate > 0)
+				return (d->mRingWrite.load(std::memory_order_acquire) - d->mRingRead.load(std::memory_order_relaxed)) / mBaseSamplerate;
+			return 0;
+		}
+		return 0;
+	}
+
 	WavStream::WavStream()
 	{
 		mFilename = 0;
@@ -408,16 +876,72 @@ namespace SoLoud
 		mFiletype = WAVSTREAM_WAV;
 		mMemFile = 0;
 		mStreamFile = 0;
+		mDecodeAhead = 0;
+		mStarvations = 0;
+		mMp3SeekTable = 0;
+		mMp3SeekPointCount = 0;
+		mMp3SeekTableEnabled = true;
 	}
 	
 	WavStream::~WavStream()
 	{
 		stop();
+		waitForDecodeAhead(this);
 		delete[] mFilename;
 		delete mMemFile;
+		delete[] (drmp3_seek_point *)mMp3SeekTable;
 	}
 	
 #define MAKEDWORD(a,b,c,d) (((d) << 24) | ((c) << 16) | ((b) << 8) | (a))
+// MP3 frames between seek points, about 0.2s at 44.1kHz
+#define MP3_SEEK_SPACING 8
+// Bytes read at a seek point to check its first frames
+#define MP3_SEEK_PROBE 8192
+
+	// drmp3 restarts at a seek point with an empty bit reservoir, so the first
+	// frames there may fail to decode and get skipped, leaving the seek a frame
+	// or two late. Replay each restart with the frame decoder and move the
+	// point past the skipped frames; drop points that can't be checked.
+	static unsigned int fixMp3SeekPoints(File *aFile, drmp3_seek_point *aPoints, unsigned int aCount)
+	{
+		unsigned char *buf = new unsigned char[MP3_SEEK_PROBE];
+		unsigned int i, n = 0;
+		for (i = 0; i < aCount; i++)
+		{
+			drmp3_seek_point p = aPoints[i];
+			aFile->seek((int)p.seekPosInBytes);
+			unsigned int len = aFile->read(buf, MP3_SEEK_PROBE);
+			drmp3dec dec;
+			drmp3dec_init(&dec);
+			unsigned int pos = 0, decoded = 0, skipped = 0, samples = 0;
+			while (decoded < p.mp3FramesToDiscard && pos < len)
+			{
+				drmp3dec_frame_info info;
+				memset(&info, 0, sizeof(info));
+				int got = drmp3dec_decode_frame(&dec, buf + pos, len - pos, NULL, &info);
+				if (info.frame_bytes == 0)
+					break;
+				pos += info.frame_bytes;
+				if (got > 0)
+				{
+					decoded++;
+					samples = got;
+				}
+				else if (info.hz)
+				{
+					skipped++;
+				}
+			}
+			if (decoded < p.mp3FramesToDiscard)
+				continue;
+			p.pcmFrameIndex += skipped * samples;
+			if (n > 0 && p.pcmFrameIndex <= aPoints[n - 1].pcmFrameIndex)
+				continue;
+			aPoints[n++] = p;
+		}
+		delete[] buf;
+		return n;
+	}
 
 	result WavStream::loadwav(File * fp)
 	{
@@ -501,11 +1025,32 @@ namespace SoLoud
 			mChannels = MAX_CHANNELS;
 		}
 
-		drmp3_uint64 samples = drmp3_get_pcm_frame_count(&decoder);
+		drmp3_uint64 frames = 0, samples = 0;
+		drmp3_get_mp3_and_pcm_frame_count(&decoder, &frames, &samples);
 
 		mBaseSamplerate = (float)decoder.sampleRate;
 		mSampleCount = (unsigned int)samples;
 		mFiletype = WAVSTREAM_MP3;
+
+		if (mMp3SeekTableEnabled && frames > MP3_SEEK_SPACING)
+		{
+			// A point every few mp3 frames keeps the decode after a seek short
+			drmp3_uint32 count = (drmp3_uint32)(frames / MP3_SEEK_SPACING);
+			drmp3_seek_point *table = new drmp3_seek_point[count];
+			if (drmp3_calculate_seek_points(&decoder, &count, table))
+				count = fixMp3SeekPoints(fp, table, count);
+			else
+				count = 0;
+			if (count > 0)
+			{
+				mMp3SeekTable = table;
+				mMp3SeekPointCount = count;
+			}
+			else
+			{
+				delete[] table;
+			}
+		}
 		drmp3_uninit(&decoder);
 
 		return SO_NO_ERROR;
@@ -513,6 +1058,7 @@ namespace SoLoud
 
 	result WavStream::load(const char *aFilename)
 	{
+		waitForDecodeAhead(this);
 		delete[] mFilename;
 		delete mMemFile;
 		mMemFile = 0;
@@ -542,6 +1088,7 @@ namespace SoLoud
 
 	result WavStream::loadMem(const unsigned char *aData, unsigned int aDataLen, bool aCopy, bool aTakeOwnership)
 	{
+		waitForDecodeAhead(this);
 		delete[] mFilename;
 		delete mMemFile;
 		mStreamFile = 0;
@@ -586,6 +1133,7 @@ namespace SoLoud
 
 	result WavStream::loadFile(File *aFile)
 	{
+		waitForDecodeAhead(this);
 		delete[] mFilename;
 		delete mMemFile;
 		mStreamFile = 0;
@@ -607,6 +1155,7 @@ namespace SoLoud
 
 	result WavStream::loadFileToMem(File *aFile)
 	{
+		waitForDecodeAhead(this);
 		delete[] mFilename;
 		delete mMemFile;
 		mStreamFile = 0;
@@ -636,8 +1185,27 @@ namespace SoLoud
 	}
 
 
+	result WavStream::loadBank(SoundBank *aBank, const char *aName)
+	{
+		if (aBank == 0 || aName == 0)
+			return INVALID_PARAMETER;
+		int entry = aBank->find(aName);
+		if (entry < 0 || !aBank->getEntryData(entry))
+			return FILE_NOT_FOUND;
+		return loadMem(aBank->getEntryData(entry), aBank->getEntryLength(entry), false, false);
+	}
+
 	result WavStream::parse(File *aFile)
 	{
+		if (mMp3SeekTable)
+		{
+			// Playing instances have it bound
+			stop();
+			waitForDecodeAhead(this);
+			delete[] (drmp3_seek_point *)mMp3SeekTable;
+			mMp3SeekTable = 0;
+			mMp3SeekPointCount = 0;
+		}
 		int tag = aFile->read32();
 		int res = SO_NO_ERROR;
 		if (tag == MAKEDWORD('O', 'g', 'g', 'S'))
@@ -666,6 +1234,21 @@ namespace SoLoud
 		return res;
 	}
 
+	void WavStream::setDecodeAhead(time aSeconds)
+	{
+		mDecodeAhead = aSeconds > 0 ? aSeconds : 0;
+	}
+
+	void WavStream::setMp3SeekTable(bool aEnable)
+	{
+		mMp3SeekTableEnabled = aEnable;
+	}
+
+	unsigned int WavStream::getStarvationCount()
+	{
+		return mStarvations.load(std::memory_order_relaxed);
+	}
+
 	AudioSourceInstance *WavStream::createInstance()
 	{
 		return new WavStreamInstance(this);
@@ -22,13 +22,17 @@ freely, subject to the following restrictions:
    distribution.
 */
 
+#include <chrono>
 #include <float.h>  // _controlfp
 #include <math.h>   // sin
 #include <stdlib.h>
 #include <string.h>
 
+#include <utility>  // integer_sequence
+
 #include "soloud_fft.h"
 #include "soloud_internal.h"
+#include "soloud_rtcheck.h"
 #include "soloud_thread.h"
 
 #ifdef SOLOUD_SSE_INTRINSICS
@@ -101,6 +105,8 @@ Soloud::Soloud() {
   mResampler = SOLOUD_DEFAULT_RESAMPLER;
   mInsideAudioThreadMutex = false;
   mScratchSize = 0;
+  mSeekPool = NULL;
+  mPendingSeeks = 0;
   mSamplerate = 0;
   mBufferSize = 0;
   mFlags = 0;
@@ -120,10 +126,45 @@ Soloud::Soloud() {
   mBackendID = 0;
   mActiveVoiceDirty = true;
   mActiveVoiceCount = 0;
+  mUnlistedVoices = 0;
+  mSilentSamples = 0;
+  mIdle = false;
+  mIdleSnapshot = false;
+  mMixCount = 0;
+  mMixSamples = 0;
+  mDirectVoices = 0;
+  mDirectVoiceCountSnapshot = 0;
+  mGovernorEnabled = false;
+  mGovernorLevel = GOVERNOR_FULL;
+  mGovernorLevelSnapshot = GOVERNOR_FULL;
+  mGovernorMaxLevel = GOVERNOR_LIMIT_VOICES;
+  mGovernorHighLoad = 0.8f;
+  mGovernorLowLoad = 0.5f;
+  mGovernorHoldBuffers = 50;
+  mGovernorCalmBuffers = 0;
+  mGovernorVoiceLimit = 0;
+  mGovernorCallback = NULL;
+  mGovernorUserData = NULL;
+  mMixLoadSnapshot = 0;
   int i;
   for (i = 0; i < VOICE_COUNT; i++) {
     mActiveVoice[i] = 0;
+    mVoiceState[i] = 0;
+    mVoiceVolume[i] = 0;
+    mVoiceSpeed[i] = 1;
+    mVoiceStreamTime[i] = 0;
+    mVoicePositionDelta[i] = 0;
+    mVoiceSnapshot[i].mSequence = 0;
+    mVoiceSnapshot[i].mHandle = 0;
+    mVoiceGeneration[i] = 0;
+    mVoiceSourceLink[i].mSource = NULL;
+    mVoiceSourceLink[i].mPrev = -1;
+    mVoiceSourceLink[i].mNext = -1;
+    mVoiceSourceLink[i].mListed = false;
+    mVoiceGroupMembership[i] = -1;
   }
+  mVoiceCountSnapshot = 0;
+  mActiveVoiceCountSnapshot = 0;
   for (i = 0; i < FILTERS_PER_STREAM; i++) {
     mFilter[i] = NULL;
     mFilterInstance[i] = NULL;
@@ -141,6 +182,15 @@ Soloud::Soloud() {
   }
   mVoiceGroup = 0;
   mVoiceGroupCount = 0;
+  mVoiceGroupMember = NULL;
+  mVoiceGroupMemberCount = 0;
+  mVoiceGroupMemberFree = -1;
+  mVirtualVoice = NULL;
+  mVirtualVoiceCapacity = 0;
+  mVirtualVoiceFree = -1;
+  mVirtualVoiceCount = 0;
+  mVirtualVoiceLimit = SOLOUD_DEFAULT_VIRTUAL_VOICE_LIMIT;
+  mVirtualVoiceRank = NULL;
 
   m3dPosition[0] = 0;
   m3dPosition[1] = 0;
@@ -172,10 +222,10 @@ Soloud::~Soloud() {
   for (i = 0; i < FILTERS_PER_STREAM; i++) {
     delete mFilterInstance[i];
   }
-  for (i = 0; i < mVoiceGroupCount; i++) {
-    delete[] mVoiceGroup[i];
-  }
   delete[] mVoiceGroup;
+  delete[] mVoiceGroupMember;
+  delete[] mVirtualVoice;
+  delete[] mVirtualVoiceRank;
   delete[] mResampleData;
   delete[] mResampleDataOwner;
 }
@@ -186,6 +236,21 @@ void Soloud::deinit() {
   unlockAudioMutex_internal();
   SOLOUD_ASSERT(!mInsideAudioThreadMutex);
   stopAll();
+  // Stopped voices that are still seeking are deleted by their seek task;
+  // let those finish before the mutex goes away.
+  if (mSeekPool) {
+    for (;;) {
+      lockAudioMutex_internal();
+      unsigned int pending = mPendingSeeks;
+      unlockAudioMutex_internal();
+      if (pending == 0) {
+        break;
+      }
+      Thread::sleep(1);
+    }
+    delete mSeekPool;
+    mSeekPool = NULL;
+  }
   if (mBackendCleanupFunc) {
     mBackendCleanupFunc(this);
   }
@@ -198,8 +263,7 @@ void Soloud::deinit() {
 
 result Soloud::init(unsigned int aFlags, unsigned int aBackend,
   unsigned int aSamplerate, unsigned int aBufferSize, unsigned int aChannels) {
-  if (aBackend >= BACKEND_MAX || aChannels == 3 || aChannels == 5 ||
-      aChannels == 7 || aChannels > MAX_CHANNELS) {
+  if (aBackend >= BACKEND_MAX || !isValidChannelCount(aChannels)) {
     return INVALID_PARAMETER;
   }
 
@@ -279,6 +343,7 @@ void Soloud::postinit_internal(unsigned int aSamplerate,
   }
   mScratch.init(mScratchSize * MAX_CHANNELS);
   mOutputScratch.init(mScratchSize * MAX_CHANNELS);
+  mSeekScratch.init(mScratchSize * MAX_CHANNELS);
   mResampleData = new float*[mMaxActiveVoices * 2];
   mResampleDataOwner = new AudioSourceInstance*[mMaxActiveVoices];
   mResampleDataBuffer.init(
@@ -384,6 +449,16 @@ void Soloud::postinit_internal(unsigned int aSamplerate,
       m3dSpeakerPosition[7 * 3 + 1] = 0;
       m3dSpeakerPosition[7 * 3 + 2] = -1;
       break;
+    default:
+      // Larger arrays: spread the speakers evenly around the listener,
+      // starting at the front left one.
+      for (i = 0; i < mChannels; i++) {
+        float a = (float)(M_PI / 4 - 2 * M_PI * i / mChannels);
+        m3dSpeakerPosition[i * 3 + 0] = 2 * (float)sin(a);
+        m3dSpeakerPosition[i * 3 + 1] = 0;
+        m3dSpeakerPosition[i * 3 + 2] = (float)cos(a);
+      }
+      break;
   }
 }
 
@@ -728,9 +803,405 @@ static void resample_point(float* aSrc, float* aSrc1, float* aDst,
   }
 }
 
-void panAndExpand(AudioSourceInstance* aVoice, float* aBuffer,
+// Check whether all channels of a block are below the silence threshold. Exits
+// on the first audible sample, so non-silent blocks are cheap to reject.
+static bool isBlockSilent(const float* aBuffer, unsigned int aSamples,
+  unsigned int aBufferSize, unsigned int aChannels) {
+  unsigned int i, j;
+  for (j = 0; j < aChannels; j++) {
+    const float* b = aBuffer + j * aBufferSize;
+    for (i = 0; i < aSamples; i++) {
+      if (b[i] > SOLOUD_SILENCE_THRESHOLD || b[i] < -SOLOUD_SILENCE_THRESHOLD) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Gain from voice channel aIn to output channel aOut when mixing an
+// aInChannels voice into aOutChannels outputs. Speaker volumes are applied on
+// top of this per output channel.
+static constexpr float channelGain(unsigned int aOutChannels,
+  unsigned int aInChannels, unsigned int aOut, unsigned int aIn) {
+  if (aOutChannels == 1 || aInChannels == 1) {
+    // Mono target sums everything, mono source feeds every speaker.
+    return 1.0f;
+  }
+  if (aOutChannels == aInChannels) {
+    return aOut == aIn ? 1.0f : 0.0f;
+  }
+  switch (aOutChannels * 16 + aInChannels) {
+    case 0x24:  // 4->2, just sum lefties and righties
+      return (aIn & 1) == aOut ? 0.5f : 0.0f;
+    case 0x26:  // 6->2, sum lefties and righties, add a bit of center and sub
+      return ((aIn & 1) == aOut || aIn == 2 || aIn == 3) ? 0.3f : 0.0f;
+    case 0x28:  // 8->2, same as above
+      return ((aIn & 1) == aOut || aIn == 2 || aIn == 3) ? 0.2f : 0.0f;
+    case 0x42:  // 2->4
+      return (aOut & 1) == aIn ? 1.0f : 0.0f;
+    case 0x46:  // 6->4, add a bit of center and sub to the front
+      if (aOut < 2) {
+        return aIn == aOut ? 1.0f : (aIn == 2 || aIn == 3) ? 0.7f : 0.0f;
+      }
+      return aIn == aOut + 2 ? 1.0f : 0.0f;
+    case 0x48:  // 8->4, as 6->4 with sides and backs averaged
+      if (aOut < 2) {
+        return aIn == aOut ? 1.0f : (aIn == 2 || aIn == 3) ? 0.7f : 0.0f;
+      }
+      return (aIn == aOut + 2 || aIn == aOut + 4) ? 0.5f : 0.0f;
+    case 0x62:  // 2->6
+    case 0x82:  // 2->8
+      if (aOut == 2 || aOut == 3) {
+        return 0.5f;
+      }
+      return (aOut & 1) == aIn ? 1.0f : 0.0f;
+    case 0x64:  // 4->6
+    case 0x84:  // 4->8
+      if (aOut < 2) {
+        return aIn == aOut ? 1.0f : 0.0f;
+      }
+      if (aOut == 2) {
+        return aIn < 2 ? 0.5f : 0.0f;
+      }
+      if (aOut == 3) {
+        return 0.25f;
+      }
+      if (aOutChannels == 6) {
+        return aIn == aOut - 2 ? 1.0f : 0.0f;
+      }
+      if (aOut < 6) {
+        return (aIn & 1) == (aOut & 1) ? 0.5f : 0.0f;
+      }
+      return aIn == aOut - 4 ? 1.0f : 0.0f;
+    case 0x68:  // 8->6, average sides and backs
+      if (aOut < 4) {
+        return aIn == aOut ? 1.0f : 0.0f;
+      }
+      return (aIn == aOut || aIn == aOut + 2) ? 0.5f : 0.0f;
+    case 0x86:  // 6->8, sides get a blend of front and back
+      if (aOut < 4) {
+        return aIn == aOut ? 1.0f : 0.0f;
+      }
+      if (aOut < 6) {
+        return (aIn == aOut || aIn == aOut - 4) ? 0.5f : 0.0f;
+      }
+      return aIn == aOut - 2 ? 1.0f : 0.0f;
+  }
+  // Other layouts: wrap the source channels around the speakers, averaging
+  // where several land on the same one.
+  if (aInChannels < aOutChannels) {
+    return aOut % aInChannels == aIn ? 1.0f : 0.0f;
+  }
+  if (aIn % aOutChannels != aOut) {
+    return 0.0f;
+  }
+  return 1.0f / (float)((aInChannels + aOutChannels - 1 - aOut) / aOutChannels);
+}
+
+struct ChannelMatrix {
+  float m[8][8];
+};
+
+static constexpr ChannelMatrix makeChannelMatrix(
+  unsigned int aOutChannels, unsigned int aInChannels) {
+  ChannelMatrix r = {};
+  for (unsigned int o = 0; o < aOutChannels; o++) {
+    for (unsigned int i = 0; i < aInChannels; i++) {
+      r.m[o][i] = channelGain(aOutChannels, aInChannels, o, i);
+    }
+  }
+  return r;
+}
+
+// Accumulates IN channels of aScratch into OUT channels of aBuffer through the
+// channel matrix, ramping each output from aPan by aPanInc per sample. The
+// matrix is a compile time constant, so unused terms are never emitted.
+template <unsigned int IN, unsigned int OUT>
+struct ChannelMixer {
+  typedef std::make_integer_sequence<unsigned int, IN> Inputs;
+  typedef std::make_integer_sequence<unsigned int, OUT> Outputs;
+
+  static constexpr ChannelMatrix mMatrix = makeChannelMatrix(OUT, IN);
+
+  // First input feeding output aOut; its term starts the sum
+  static constexpr unsigned int firstInput(unsigned int aOut) {
+    unsigned int i = 0;
+    while (i < IN && mMatrix.m[aOut][i] == 0.0f) {
+      i++;
+    }
+    return i;
+  }
+
+  template <unsigned int O, unsigned int I>
+  static inline float term(const float* aSrc, unsigned int aBufferSize) {
+    if constexpr (mMatrix.m[O][I] == 0.0f) {
+      return 0.0f;
+    } else {
+      return aSrc[aBufferSize * I] * mMatrix.m[O][I];
+    }
+  }
+
+  // Scalar samples from aFrom onwards for output O
+  template <unsigned int O, unsigned int... I>
+  static inline void tail(const float* aScratch, float* aBuffer,
+    unsigned int aFrom, unsigned int aSamples, unsigned int aBufferSize,
+    float aPan, float aPanInc, std::integer_sequence<unsigned int, I...>) {
+    float* dst = aBuffer + aBufferSize * O;
+    float p = aPan + aPanInc * aFrom;
+    for (unsigned int j = aFrom; j < aSamples; j++) {
+      p += aPanInc;
+      dst[j] += (term<O, I>(aScratch + j, aBufferSize) + ...) * p;
+    }
+  }
+
+#ifdef SOLOUD_SSE_INTRINSICS
+  // Load four samples of each input. Loads no output uses are optimized out.
+  template <unsigned int... I>
+  static inline void load4(const float* aSrc, unsigned int aBufferSize,
+    __m128* aIn, std::integer_sequence<unsigned int, I...>) {
+    ((aIn[I] = _mm_load_ps(aSrc + aBufferSize * I)), ...);
+  }
+
+  template <unsigned int O, unsigned int I>
+  static inline __m128 term4(__m128 aAcc, const __m128* aIn) {
+    if constexpr (mMatrix.m[O][I] == 0.0f) {
+      return aAcc;
+    } else {
+      __m128 v = aIn[I];
+      if constexpr (mMatrix.m[O][I] != 1.0f) {
+        v = _mm_mul_ps(v, _mm_set1_ps(mMatrix.m[O][I]));
+      }
+      if constexpr (I == firstInput(O)) {
+        return v;
+      } else {
+        return _mm_add_ps(aAcc, v);
+      }
+    }
+  }
+
+  // Four samples of output O, advancing its pan ramp by aPanInc
+  template <unsigned int O, unsigned int... I>
+  static inline void quad(const __m128* aIn, float* aDst,
+    unsigned int aBufferSize, __m128& aPan, __m128 aPanInc,
+    std::integer_sequence<unsigned int, I...>) {
+    __m128 acc = _mm_setzero_ps();  // stays zero if the row is empty
+    ((acc = term4<O, I>(acc, aIn)), ...);
+    float* dst = aDst + aBufferSize * O;
+    _mm_store_ps(dst, _mm_add_ps(_mm_load_ps(dst), _mm_mul_ps(acc, aPan)));
+    aPan = _mm_add_ps(aPan, aPanInc);
+  }
+
+  static inline __m128 panStart(float aPan, float aPanInc) {
+    return _mm_setr_ps(aPan + aPanInc, aPan + aPanInc * 2,
+      aPan + aPanInc * 3, aPan + aPanInc * 4);
+  }
+
+  // One output at a time over the whole block. Two interleaved ramps keep the
+  // pan additions from serializing the loop.
+  template <unsigned int O>
+  static inline void output(const float* aScratch, float* aBuffer,
+    unsigned int aSamples, unsigned int aBufferSize, float aPan,
+    float aPanInc) {
+    __m128 pan0 = panStart(aPan, aPanInc);
+    __m128 pan1 = _mm_add_ps(pan0, _mm_set1_ps(aPanInc * 4));
+    __m128 panInc = _mm_set1_ps(aPanInc * 8);
+    __m128 in0[IN], in1[IN];
+    unsigned int j = 0;
+    for (; j + 8 <= aSamples; j += 8) {
+      load4(aScratch + j, aBufferSize, in0, Inputs());
+      load4(aScratch + j + 4, aBufferSize, in1, Inputs());
+      quad<O>(in0, aBuffer + j, aBufferSize, pan0, panInc, Inputs());
+      quad<O>(in1, aBuffer + j + 4, aBufferSize, pan1, panInc, Inputs());
+    }
+    if (j + 4 <= aSamples) {
+      load4(aScratch + j, aBufferSize, in0, Inputs());
+      quad<O>(in0, aBuffer + j, aBufferSize, pan0, panInc, Inputs());
+      j += 4;
+    }
+    tail<O>(aScratch, aBuffer, j, aSamples, aBufferSize, aPan, aPanInc,
+      Inputs());
+  }
+
+  template <unsigned int... O>
+  static inline void mixOutputs(const float* aScratch, float* aBuffer,
+    unsigned int aSamples, unsigned int aBufferSize, const float* aPan,
+    const float* aPanInc, std::integer_sequence<unsigned int, O...>) {
+    if constexpr (OUT <= 2) {
+      // Few outputs: share each source load between them in a single pass.
+      __m128 pan[OUT] = {panStart(aPan[O], aPanInc[O])...};
+      __m128 panInc[OUT] = {_mm_set1_ps(aPanInc[O] * 4)...};
+      __m128 in[IN];
+      unsigned int j = 0;
+      for (; j + 4 <= aSamples; j += 4) {
+        load4(aScratch + j, aBufferSize, in, Inputs());
+        (quad<O>(in, aBuffer + j, aBufferSize, pan[O], panInc[O], Inputs()),
+          ...);
+      }
+      (tail<O>(aScratch, aBuffer, j, aSamples, aBufferSize, aPan[O],
+         aPanInc[O], Inputs()),
+        ...);
+    } else {
+      (output<O>(aScratch, aBuffer, aSamples, aBufferSize, aPan[O],
+         aPanInc[O]),
+        ...);
+    }
+  }
+#else
+  template <unsigned int... O>
+  static inline void mixOutputs(const float* aScratch, float* aBuffer,
+    unsigned int aSamples, unsigned int aBufferSize, const float* aPan,
+    const float* aPanInc, std::integer_sequence<unsigned int, O...>) {
+    (tail<O>(aScratch, aBuffer, 0, aSamples, aBufferSize, aPan[O], aPanInc[O],
+       Inputs()),
+      ...);
+  }
+#endif
+
+  static void mix(const float* aScratch, float* aBuffer, unsigned int aSamples,
+    unsigned int aBufferSize, const float* aPan, const float* aPanInc,
+    unsigned int /*aInChannels*/, unsigned int /*aOutChannels*/) {
+    mixOutputs(
+      aScratch, aBuffer, aSamples, aBufferSize, aPan, aPanInc, Outputs());
+  }
+};
+
+// Fallback for layouts without a specialized kernel, such as outputs with
+// more than 8 speakers. Walks the matrix one output channel at a time.
+static void mixChannelsGeneric(const float* aScratch, float* aBuffer,
+  unsigned int aSamples, unsigned int aBufferSize, const float* aPan,
+  const float* aPanInc, unsigned int aInChannels, unsigned int aOutChannels) {
+  unsigned int o, i, k;
+  for (o = 0; o < aOutChannels; o++) {
+    float* dst = aBuffer + aBufferSize * o;
+    float p = aPan[o];
+    float pi = aPanInc[o];
+    for (i = 0; i < aInChannels; i++) {
+      float g = channelGain(aOutChannels, aInChannels, o, i);
+      if (g == 0.0f) {
+        continue;
+      }
+      // Each term ramps the same way, so the pan can be folded in per term.
+      const float* src = aScratch + aBufferSize * i;
+      for (k = 0; k < aSamples; k++) {
+        dst[k] += src[k] * g * (p + pi * (k + 1));
+      }
+    }
+  }
+}
+
+typedef void (*ChannelMixFunction)(const float* aScratch, float* aBuffer,
+  unsigned int aSamples, unsigned int aBufferSize, const float* aPan,
+  const float* aPanInc, unsigned int aInChannels, unsigned int aOutChannels);
+
+// Index of a 1, 2, 4, 6 or 8 channel layout in the kernel tables, or -1 if
+// there is no specialized kernel for it
+static int channelLayoutIndex(unsigned int aChannels) {
+  static const signed char index[9] = {-1, 0, 1, -1, 2, -1, 3, -1, 4};
+  return aChannels < 9 ? index[aChannels] : -1;
+}
+
+#define SOLOUD_MIXROW(in)                                                      \
+  {ChannelMixer<in, 1>::mix, ChannelMixer<in, 2>::mix,                         \
+    ChannelMixer<in, 4>::mix, ChannelMixer<in, 6>::mix,                        \
+    ChannelMixer<in, 8>::mix}
+static const ChannelMixFunction gChannelMix[5][5] = {SOLOUD_MIXROW(1),
+  SOLOUD_MIXROW(2), SOLOUD_MIXROW(4), SOLOUD_MIXROW(6), SOLOUD_MIXROW(8)};
+#undef SOLOUD_MIXROW
+
+static ChannelMixFunction channelMixFunction(
+  unsigned int aInChannels, unsigned int aOutChannels) {
+  int in = channelLayoutIndex(aInChannels);
+  int out = channelLayoutIndex(aOutChannels);
+  if (in < 0 || out < 0) {
+    return mixChannelsGeneric;
+  }
+  return gChannelMix[in][out];
+}
+
+// Resamples every channel of a voice block in one pass, so the source
+// position and fraction are worked out once per output sample. CHANNELS of 0
+// handles any channel count one channel at a time.
+template <unsigned int RESAMPLER, unsigned int CHANNELS>
+static void resampleVoice(float* aSrc, float* aSrc1, float* aDst,
+  unsigned int aDstStride, unsigned int aChannels, int aSrcOffset,
+  int aDstSampleCount, int aStepFixed) {
+  unsigned int c;
+  if constexpr (CHANNELS == 0) {
+    for (c = 0; c < aChannels; c++) {
+      float* src = aSrc + SAMPLE_GRANULARITY * c;
+      float* src1 = aSrc1 + SAMPLE_GRANULARITY * c;
+      float* dst = aDst + aDstStride * c;
+      if constexpr (RESAMPLER == Soloud::RESAMPLER_POINT) {
+        resample_point(src, src1, dst, aSrcOffset, aDstSampleCount, aStepFixed);
+      } else if constexpr (RESAMPLER == Soloud::RESAMPLER_CATMULLROM) {
+        resample_catmullrom(
+          src, src1, dst, aSrcOffset, aDstSampleCount, aStepFixed);
+      } else {
+        resample_linear(
+          src, src1, dst, aSrcOffset, aDstSampleCount, aStepFixed);
+      }
+    }
+  } else {
+    int i;
+    int pos = aSrcOffset;
+    for (i = 0; i < aDstSampleCount; i++, pos += aStepFixed) {
+      int p = pos >> FIXPOINT_FRAC_BITS;
+      int f = pos & FIXPOINT_FRAC_MASK;
+      for (c = 0; c < CHANNELS; c++) {
+        float* src = aSrc + SAMPLE_GRANULARITY * c;
+        float* src1 = aSrc1 + SAMPLE_GRANULARITY * c;
+        if constexpr (RESAMPLER == Soloud::RESAMPLER_POINT) {
+          aDst[aDstStride * c + i] = src[p];
+        } else if constexpr (RESAMPLER == Soloud::RESAMPLER_CATMULLROM) {
+          float s1, s2, s3;
+          if (p < 3) {
+            s3 = src1[SAMPLE_GRANULARITY + p - 3];
+            s2 = p < 2 ? src1[SAMPLE_GRANULARITY + p - 2] : src[p - 2];
+            s1 = p < 1 ? src1[SAMPLE_GRANULARITY + p - 1] : src[p - 1];
+          } else {
+            s3 = src[p - 3];
+            s2 = src[p - 2];
+            s1 = src[p - 1];
+          }
+          aDst[aDstStride * c + i] =
+            catmullrom(f / (float)FIXPOINT_FRAC_MUL, s3, s2, s1, src[p]);
+        } else {
+          float s1 = p != 0 ? src[p - 1] : src1[SAMPLE_GRANULARITY - 1];
+          float s2 = src[p];
+          aDst[aDstStride * c + i] =
+            s1 + (s2 - s1) * f * (1 / (float)FIXPOINT_FRAC_MUL);
+        }
+      }
+    }
+  }
+}
+
+typedef void (*ResampleFunction)(float* aSrc, float* aSrc1, float* aDst,
+  unsigned int aDstStride, unsigned int aChannels, int aSrcOffset,
+  int aDstSampleCount, int aStepFixed);
+
+// Column 0 is the generic kernel, the rest follow channelLayoutIndex
+#define SOLOUD_RESAMPLEROW(r)                                                  \
+  {resampleVoice<r, 0>, resampleVoice<r, 1>, resampleVoice<r, 2>,              \
+    resampleVoice<r, 4>, resampleVoice<r, 6>, resampleVoice<r, 8>}
+static const ResampleFunction gResample[3][6] = {
+  SOLOUD_RESAMPLEROW(Soloud::RESAMPLER_POINT),
+  SOLOUD_RESAMPLEROW(Soloud::RESAMPLER_LINEAR),
+  SOLOUD_RESAMPLEROW(Soloud::RESAMPLER_CATMULLROM)};
+#undef SOLOUD_RESAMPLEROW
+
+static ResampleFunction resampleFunction(
+  unsigned int aResampler, unsigned int aChannels) {
+  if (aResampler > Soloud::RESAMPLER_CATMULLROM) {
+    aResampler = Soloud::RESAMPLER_LINEAR;
+  }
+  return gResample[aResampler][channelLayoutIndex(aChannels) + 1];
+}
+
+static void panAndExpand(AudioSourceInstance* aVoice, float* aBuffer,
   unsigned int aSamplesToRead, unsigned int aBufferSize, float* aScratch,
-  unsigned int aChannels) {
+  unsigned int aChannels, ChannelMixFunction aMix) {
 #ifdef SOLOUD_SSE_INTRINSICS
   SOLOUD_ASSERT(((size_t)aBuffer & 0xf) == 0);
   SOLOUD_ASSERT(((size_t)aScratch & 0xf) == 0);
@@ -739,7 +1210,7 @@ void panAndExpand(AudioSourceInstance* aVoice, float* aBuffer,
   float pan[MAX_CHANNELS];   // current speaker volume
   float pand[MAX_CHANNELS];  // destination speaker volume
   float pani[MAX_CHANNELS];  // speaker volume increment per sample
-  unsigned int j, k;
+  unsigned int k;
   for (k = 0; k < aChannels; k++) {
     pan[k] = aVoice->mCurrentChannelVolume[k];
     pand[k] = aVoice->mChannelVolume[k] * aVoice->mOverallVolume;
@@ -748,524 +1219,293 @@ void panAndExpand(AudioSourceInstance* aVoice, float* aBuffer,
                                // hack to begin with
   }
 
-  int ofs = 0;
-  switch (aChannels) {
-    case 1:  // Target is mono. Sum everything. (1->1, 2->1, 4->1, 6->1, 8->1)
-      for (j = 0, ofs = 0; j < aVoice->mChannels; j++, ofs += aBufferSize) {
-        pan[0] = aVoice->mCurrentChannelVolume[0];
-        for (k = 0; k < aSamplesToRead; k++) {
-          pan[0] += pani[0];
-          aBuffer[k] += aScratch[ofs + k] * pan[0];
+  aMix(aScratch, aBuffer, aSamplesToRead, aBufferSize, pan, pani,
+    aVoice->mChannels, aChannels);
+
+  for (k = 0; k < aChannels; k++) {
+    aVoice->mCurrentChannelVolume[k] = pand[k];
+  }
+}
+
+// Voices mixed straight from their source's memory, see mixDirect
+struct DirectVoice {
+  AudioSourceInstance* mVoice;
+  unsigned int mSlot;
+  const float* mData;
+  unsigned int mChannelStride;
+  unsigned int mSamples;
+  unsigned int mHistory;
+  // Delay of the resampler the voice would otherwise go through, kept so
+  // switching paths doesn't shift the voice.
+  unsigned int mLatency;
+  // Output samples before the voice's first sample when it has less history
+  // than mLatency; they read as silence, as from a fresh resample buffer.
+  unsigned int mLead;
+  // Output samples after the data runs out, flushing the latency
+  unsigned int mTail;
+};
+
+// Most direct voices gathered per bus mix; the rest take the regular path
+#define DIRECT_VOICES 64
+// Voices of one source accumulated per pass over the output
+#define DIRECT_BATCH 4
+
+// A voice can skip getAudio and the resampler when it plays at the bus rate
+// from a source that exposes its samples, with nothing else in between.
+static bool canMixDirect(AudioSourceInstance* aVoice, unsigned int aSkipFilters,
+  unsigned int aResampler, unsigned int aSamplesToRead, DirectVoice& aDirect) {
+  // The regular path leaves the playhead at the end of the block it used up,
+  // which is as aligned as the start of the next one.
+  if (aVoice->mDelaySamples || aVoice->mLeftoverSamples ||
+      (aVoice->mSrcOffset != 0 &&
+        aVoice->mSrcOffset != SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL) ||
+      (aVoice->mFlags &
+        (AudioSourceInstance::BUS | AudioSourceInstance::HAS_SENDS))) {
+    return false;
+  }
+  unsigned int j;
+  for (j = 0; j < FILTERS_PER_STREAM; j++) {
+    if (aVoice->mFilter[j] && !(aSkipFilters & (1 << j))) {
+      return false;
+    }
+  }
+  aDirect.mData = aVoice->getDirectData(
+    aDirect.mSamples, aDirect.mHistory, aDirect.mChannelStride);
+  // At unit step the point resampler is exact, linear lags by one sample
+  // and catmull-rom by two.
+  aDirect.mLatency = aResampler;
+  // An ended voice left running flushes the latency on the regular path.
+  if (!aDirect.mData || aDirect.mSamples == 0) {
+    return false;
+  }
+  aDirect.mLead = aDirect.mHistory < aDirect.mLatency
+                    ? aDirect.mLatency - aDirect.mHistory
+                    : 0;
+  // Looping needs the regular path to wrap around.
+  if ((aVoice->mFlags & AudioSourceInstance::LOOPING) &&
+      aDirect.mSamples < aSamplesToRead) {
+    return false;
+  }
+  if (aDirect.mSamples > aSamplesToRead) {
+    aDirect.mSamples = aSamplesToRead;
+  }
+  aDirect.mTail = aSamplesToRead - aDirect.mSamples;
+  if (aDirect.mTail > aDirect.mLatency) {
+    aDirect.mTail = aDirect.mLatency;
+  }
+  if (aDirect.mLead >= aDirect.mSamples + aDirect.mTail) {
+    return false;
+  }
+  aVoice->mSrcOffset = 0;
+  aDirect.mVoice = aVoice;
+  return true;
+}
+
+// Pan and accumulate N voices with the same channel count in one pass over
+// the output. aRamp is the length the volume ramps are spread over.
+template <unsigned int N>
+static void mixDirectBatch(const DirectVoice* aVoices, float* aBuffer,
+  unsigned int aSamples, unsigned int aRamp, unsigned int aBufferSize,
+  unsigned int aChannels) {
+  unsigned int inchannels = aVoices[0].mVoice->mChannels;
+  // Only voices mixed on their own have a lead
+  unsigned int lead = aVoices[0].mLead;
+  unsigned int o, i, v, k;
+  for (o = 0; o < aChannels; o++) {
+    float p[N], pi[N];
+    for (v = 0; v < N; v++) {
+      AudioSourceInstance* voice = aVoices[v].mVoice;
+      p[v] = voice->mCurrentChannelVolume[o];
+      pi[v] =
+        (voice->mChannelVolume[o] * voice->mOverallVolume - p[v]) / aRamp;
+    }
+    float* dst = aBuffer + aBufferSize * o;
+    for (i = 0; i < inchannels; i++) {
+      float g = channelGain(aChannels, inchannels, o, i);
+      if (g == 0.0f) {
+        continue;
+      }
+      const float* src[N];
+      for (v = 0; v < N; v++) {
+        src[v] = aVoices[v].mData + aVoices[v].mChannelStride * i -
+                 aVoices[v].mLatency;
+      }
+      k = lead;
+#ifdef SOLOUD_SSE_INTRINSICS
+      // Source data sits at arbitrary offsets; the output is aligned.
+      for (; k < aSamples && (k & 3); k++) {
+        float acc = 0;
+        for (v = 0; v < N; v++) {
+          acc += src[v][k] * (p[v] + pi[v] * (k + 1));
         }
+        dst[k] += acc * g;
       }
-      break;
-    case 2:
-      switch (aVoice->mChannels) {
-        case 8:  // 8->2, just sum lefties and righties, add a bit of center and
-                 // sub?
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            float s7 = aScratch[aBufferSize * 6 + j];
-            float s8 = aScratch[aBufferSize * 7 + j];
-            aBuffer[j + 0] += 0.2f * (s1 + s3 + s4 + s5 + s7) * pan[0];
-            aBuffer[j + aBufferSize] +=
-              0.2f * (s2 + s3 + s4 + s6 + s8) * pan[1];
-          }
-          break;
-        case 6:  // 6->2, just sum lefties and righties, add a bit of center and
-                 // sub?
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            aBuffer[j + 0] += 0.3f * (s1 + s3 + s4 + s5) * pan[0];
-            aBuffer[j + aBufferSize] += 0.3f * (s2 + s3 + s4 + s6) * pan[1];
-          }
-          break;
-        case 4:  // 4->2, just sum lefties and righties
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            aBuffer[j + 0] += 0.5f * (s1 + s3) * pan[0];
-            aBuffer[j + aBufferSize] += 0.5f * (s2 + s4) * pan[1];
-          }
-          break;
-        case 2:  // 2->2
-#if defined(SOLOUD_SSE_INTRINSICS)
-        {
-          int c = 0;
-          // if ((aBufferSize & 3) == 0)
-          {
-            unsigned int samplequads = aSamplesToRead / 4;  // rounded down
-            TinyAlignedFloatBuffer pan0;
-            pan0.mData[0] = pan[0] + pani[0];
-            pan0.mData[1] = pan[0] + pani[0] * 2;
-            pan0.mData[2] = pan[0] + pani[0] * 3;
-            pan0.mData[3] = pan[0] + pani[0] * 4;
-            TinyAlignedFloatBuffer pan1;
-            pan1.mData[0] = pan[1] + pani[1];
-            pan1.mData[1] = pan[1] + pani[1] * 2;
-            pan1.mData[2] = pan[1] + pani[1] * 3;
-            pan1.mData[3] = pan[1] + pani[1] * 4;
-            pani[0] *= 4;
-            pani[1] *= 4;
-            __m128 pan0delta = _mm_load_ps1(&pani[0]);
-            __m128 pan1delta = _mm_load_ps1(&pani[1]);
-            __m128 p0 = _mm_load_ps(pan0.mData);
-            __m128 p1 = _mm_load_ps(pan1.mData);
-
-            for (j = 0; j < samplequads; j++) {
-              __m128 f0 = _mm_load_ps(aScratch + c);
-              __m128 c0 = _mm_mul_ps(f0, p0);
-              __m128 f1 = _mm_load_ps(aScratch + c + aBufferSize);
-              __m128 c1 = _mm_mul_ps(f1, p1);
-              __m128 o0 = _mm_load_ps(aBuffer + c);
-              __m128 o1 = _mm_load_ps(aBuffer + c + aBufferSize);
-              c0 = _mm_add_ps(c0, o0);
-              c1 = _mm_add_ps(c1, o1);
-              _mm_store_ps(aBuffer + c, c0);
-              _mm_store_ps(aBuffer + c + aBufferSize, c1);
-              p0 = _mm_add_ps(p0, pan0delta);
-              p1 = _mm_add_ps(p1, pan1delta);
-              c += 4;
-            }
-          }
-
-          // If buffer size or samples to read are not divisible by 4, handle
-          // leftovers
-          for (j = c; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-          }
+      __m128 pan[N], paninc[N];
+      for (v = 0; v < N; v++) {
+        pan[v] = _mm_setr_ps(p[v] + pi[v] * (k + 1), p[v] + pi[v] * (k + 2),
+          p[v] + pi[v] * (k + 3), p[v] + pi[v] * (k + 4));
+        paninc[v] = _mm_set1_ps(pi[v] * 4);
+      }
+      __m128 gain = _mm_set1_ps(g);
+      for (; k + 4 <= aSamples; k += 4) {
+        __m128 acc = _mm_mul_ps(_mm_loadu_ps(src[0] + k), pan[0]);
+        pan[0] = _mm_add_ps(pan[0], paninc[0]);
+        for (v = 1; v < N; v++) {
+          acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src[v] + k), pan[v]));
+          pan[v] = _mm_add_ps(pan[v], paninc[v]);
         }
-#else  // fallback
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-          }
+        _mm_store_ps(
+          dst + k, _mm_add_ps(_mm_load_ps(dst + k), _mm_mul_ps(acc, gain)));
+      }
 #endif
-        break;
-        case 1:  // 1->2
-#if defined(SOLOUD_SSE_INTRINSICS)
-        {
-          int c = 0;
-          // if ((aBufferSize & 3) == 0)
-          {
-            unsigned int samplequads = aSamplesToRead / 4;  // rounded down
-            TinyAlignedFloatBuffer pan0;
-            pan0.mData[0] = pan[0] + pani[0];
-            pan0.mData[1] = pan[0] + pani[0] * 2;
-            pan0.mData[2] = pan[0] + pani[0] * 3;
-            pan0.mData[3] = pan[0] + pani[0] * 4;
-            TinyAlignedFloatBuffer pan1;
-            pan1.mData[0] = pan[1] + pani[1];
-            pan1.mData[1] = pan[1] + pani[1] * 2;
-            pan1.mData[2] = pan[1] + pani[1] * 3;
-            pan1.mData[3] = pan[1] + pani[1] * 4;
-            pani[0] *= 4;
-            pani[1] *= 4;
-            __m128 pan0delta = _mm_load_ps1(&pani[0]);
-            __m128 pan1delta = _mm_load_ps1(&pani[1]);
-            __m128 p0 = _mm_load_ps(pan0.mData);
-            __m128 p1 = _mm_load_ps(pan1.mData);
-
-            for (j = 0; j < samplequads; j++) {
-              __m128 f = _mm_load_ps(aScratch + c);
-              __m128 c0 = _mm_mul_ps(f, p0);
-              __m128 c1 = _mm_mul_ps(f, p1);
-              __m128 o0 = _mm_load_ps(aBuffer + c);
-              __m128 o1 = _mm_load_ps(aBuffer + c + aBufferSize);
-              c0 = _mm_add_ps(c0, o0);
-              c1 = _mm_add_ps(c1, o1);
-              _mm_store_ps(aBuffer + c, c0);
-              _mm_store_ps(aBuffer + c + aBufferSize, c1);
-              p0 = _mm_add_ps(p0, pan0delta);
-              p1 = _mm_add_ps(p1, pan1delta);
-              c += 4;
-            }
-          }
-          // If buffer size or samples to read are not divisible by 4, handle
-          // leftovers
-          for (j = c; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s = aScratch[j];
-            aBuffer[j + 0] += s * pan[0];
-            aBuffer[j + aBufferSize] += s * pan[1];
-          }
+      for (; k < aSamples; k++) {
+        float acc = 0;
+        for (v = 0; v < N; v++) {
+          acc += src[v][k] * (p[v] + pi[v] * (k + 1));
         }
-#else  // fallback
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            float s = aScratch[j];
-            aBuffer[j + 0] += s * pan[0];
-            aBuffer[j + aBufferSize] += s * pan[1];
-          }
-#endif
-        break;
-      }
-      break;
-    case 4:
-      switch (aVoice->mChannels) {
-        case 8:  // 8->4, add a bit of center, sub?
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            float s7 = aScratch[aBufferSize * 6 + j];
-            float s8 = aScratch[aBufferSize * 7 + j];
-            float c = (s3 + s4) * 0.7f;
-            aBuffer[j + 0] += s1 * pan[0] + c;
-            aBuffer[j + aBufferSize] += s2 * pan[1] + c;
-            aBuffer[j + aBufferSize * 2] += 0.5f * (s5 + s7) * pan[2];
-            aBuffer[j + aBufferSize * 3] += 0.5f * (s6 + s8) * pan[3];
-          }
-          break;
-        case 6:  // 6->4, add a bit of center, sub?
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            float c = (s3 + s4) * 0.7f;
-            aBuffer[j + 0] += s1 * pan[0] + c;
-            aBuffer[j + aBufferSize] += s2 * pan[1] + c;
-            aBuffer[j + aBufferSize * 2] += s5 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s6 * pan[3];
-          }
-          break;
-        case 4:  // 4->4
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s3 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s4 * pan[3];
-          }
-          break;
-        case 2:  // 2->4
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s1 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s2 * pan[3];
-          }
-          break;
-        case 1:  // 1->4
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            float s = aScratch[j];
-            aBuffer[j + 0] += s * pan[0];
-            aBuffer[j + aBufferSize] += s * pan[1];
-            aBuffer[j + aBufferSize * 2] += s * pan[2];
-            aBuffer[j + aBufferSize * 3] += s * pan[3];
-          }
-          break;
+        dst[k] += acc * g;
       }
-      break;
-    case 6:
-      switch (aVoice->mChannels) {
-        case 8:  // 8->6
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            float s7 = aScratch[aBufferSize * 6 + j];
-            float s8 = aScratch[aBufferSize * 7 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s3 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s4 * pan[3];
-            aBuffer[j + aBufferSize * 4] += 0.5f * (s5 + s7) * pan[4];
-            aBuffer[j + aBufferSize * 5] += 0.5f * (s6 + s8) * pan[5];
-          }
-          break;
-        case 6:  // 6->6
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s3 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s4 * pan[3];
-            aBuffer[j + aBufferSize * 4] += s5 * pan[4];
-            aBuffer[j + aBufferSize * 5] += s6 * pan[5];
-          }
-          break;
-        case 4:  // 4->6
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += 0.5f * (s1 + s2) * pan[2];
-            aBuffer[j + aBufferSize * 3] +=
-              0.25f * (s1 + s2 + s3 + s4) * pan[3];
-            aBuffer[j + aBufferSize * 4] += s3 * pan[4];
-            aBuffer[j + aBufferSize * 5] += s4 * pan[5];
-          }
-          break;
-        case 2:  // 2->6
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += 0.5f * (s1 + s2) * pan[2];
-            aBuffer[j + aBufferSize * 3] += 0.5f * (s1 + s2) * pan[3];
-            aBuffer[j + aBufferSize * 4] += s1 * pan[4];
-            aBuffer[j + aBufferSize * 5] += s2 * pan[5];
-          }
-          break;
-        case 1:  // 1->6
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            float s = aScratch[j];
-            aBuffer[j + 0] += s * pan[0];
-            aBuffer[j + aBufferSize] += s * pan[1];
-            aBuffer[j + aBufferSize * 2] += s * pan[2];
-            aBuffer[j + aBufferSize * 3] += s * pan[3];
-            aBuffer[j + aBufferSize * 4] += s * pan[4];
-            aBuffer[j + aBufferSize * 5] += s * pan[5];
-          }
-          break;
+    }
+  }
+  for (v = 0; v < N; v++) {
+    const DirectVoice& d = aVoices[v];
+    AudioSourceInstance* voice = d.mVoice;
+    for (o = 0; o < aChannels; o++) {
+      voice->mCurrentChannelVolume[o] =
+        voice->mChannelVolume[o] * voice->mOverallVolume;
+    }
+    // Leave the tail in the resample buffer, as if this block had come
+    // through getAudio, in case the voice takes the regular path next. What
+    // the flush already played is gone from it.
+    for (i = 0; i < inchannels; i++) {
+      float* dst = voice->mResampleData[0] + SAMPLE_GRANULARITY * i;
+      for (k = 1; k <= 3; k++) {
+        int ofs = (int)(d.mSamples + d.mTail) - (int)k;
+        dst[SAMPLE_GRANULARITY - k] =
+          ofs < (int)d.mSamples && ofs + (int)d.mHistory >= 0
+            ? d.mData[(int)(d.mChannelStride * i) + ofs]
+            : 0;
       }
-      break;
-    case 8:
-      switch (aVoice->mChannels) {
-        case 8:  // 8->8
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            pan[6] += pani[6];
-            pan[7] += pani[7];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            float s7 = aScratch[aBufferSize * 6 + j];
-            float s8 = aScratch[aBufferSize * 7 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s3 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s4 * pan[3];
-            aBuffer[j + aBufferSize * 4] += s5 * pan[4];
-            aBuffer[j + aBufferSize * 5] += s6 * pan[5];
-            aBuffer[j + aBufferSize * 6] += s7 * pan[6];
-            aBuffer[j + aBufferSize * 7] += s8 * pan[7];
-          }
-          break;
-        case 6:  // 6->8
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            pan[6] += pani[6];
-            pan[7] += pani[7];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            float s5 = aScratch[aBufferSize * 4 + j];
-            float s6 = aScratch[aBufferSize * 5 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += s3 * pan[2];
-            aBuffer[j + aBufferSize * 3] += s4 * pan[3];
-            aBuffer[j + aBufferSize * 4] += 0.5f * (s5 + s1) * pan[4];
-            aBuffer[j + aBufferSize * 5] += 0.5f * (s6 + s2) * pan[5];
-            aBuffer[j + aBufferSize * 6] += s5 * pan[6];
-            aBuffer[j + aBufferSize * 7] += s6 * pan[7];
-          }
-          break;
-        case 4:  // 4->8
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            pan[6] += pani[6];
-            pan[7] += pani[7];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            float s3 = aScratch[aBufferSize * 2 + j];
-            float s4 = aScratch[aBufferSize * 3 + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += 0.5f * (s1 + s2) * pan[2];
-            aBuffer[j + aBufferSize * 3] +=
-              0.25f * (s1 + s2 + s3 + s4) * pan[3];
-            aBuffer[j + aBufferSize * 4] += 0.5f * (s1 + s3) * pan[4];
-            aBuffer[j + aBufferSize * 5] += 0.5f * (s2 + s4) * pan[5];
-            aBuffer[j + aBufferSize * 6] += s3 * pan[4];
-            aBuffer[j + aBufferSize * 7] += s4 * pan[5];
-          }
-          break;
-        case 2:  // 2->8
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            pan[6] += pani[6];
-            pan[7] += pani[7];
-            float s1 = aScratch[j];
-            float s2 = aScratch[aBufferSize + j];
-            aBuffer[j + 0] += s1 * pan[0];
-            aBuffer[j + aBufferSize] += s2 * pan[1];
-            aBuffer[j + aBufferSize * 2] += 0.5f * (s1 + s2) * pan[2];
-            aBuffer[j + aBufferSize * 3] += 0.5f * (s1 + s2) * pan[3];
-            aBuffer[j + aBufferSize * 4] += s1 * pan[4];
-            aBuffer[j + aBufferSize * 5] += s2 * pan[5];
-            aBuffer[j + aBufferSize * 6] += s1 * pan[6];
-            aBuffer[j + aBufferSize * 7] += s2 * pan[7];
-          }
-          break;
-        case 1:  // 1->8
-          for (j = 0; j < aSamplesToRead; j++) {
-            pan[0] += pani[0];
-            pan[1] += pani[1];
-            pan[2] += pani[2];
-            pan[3] += pani[3];
-            pan[4] += pani[4];
-            pan[5] += pani[5];
-            pan[6] += pani[6];
-            pan[7] += pani[7];
-            float s = aScratch[j];
-            aBuffer[j + 0] += s * pan[0];
-            aBuffer[j + aBufferSize] += s * pan[1];
-            aBuffer[j + aBufferSize * 2] += s * pan[2];
-            aBuffer[j + aBufferSize * 3] += s * pan[3];
-            aBuffer[j + aBufferSize * 4] += s * pan[4];
-            aBuffer[j + aBufferSize * 5] += s * pan[5];
-            aBuffer[j + aBufferSize * 6] += s * pan[6];
-            aBuffer[j + aBufferSize * 7] += s * pan[7];
-          }
-          break;
+    }
+    voice->mResampleSilence = 0;
+    voice->skipDirectData(d.mSamples);
+  }
+}
+
+// Mix the gathered direct voices. Instances of the same source are batched
+// so that several of them are accumulated per pass over the output; voices
+// starting or ending inside this block go one at a time.
+static void mixDirect(DirectVoice* aVoices, unsigned int aCount,
+  float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize,
+  unsigned int aChannels) {
+  unsigned int i, j;
+  // Group by source; the list is short, so insertion sort will do.
+  for (i = 1; i < aCount; i++) {
+    DirectVoice d = aVoices[i];
+    for (j = i; j > 0 && aVoices[j - 1].mVoice->mAudioSourceID >
+                            d.mVoice->mAudioSourceID;
+      j--) {
+      aVoices[j] = aVoices[j - 1];
+    }
+    aVoices[j] = d;
+  }
+  i = 0;
+  while (i < aCount) {
+    unsigned int n = 1;
+    if (aVoices[i].mSamples == aSamplesToRead && aVoices[i].mLead == 0) {
+      while (n < DIRECT_BATCH && i + n < aCount &&
+             aVoices[i + n].mVoice->mAudioSourceID ==
+               aVoices[i].mVoice->mAudioSourceID &&
+             aVoices[i + n].mVoice->mChannels ==
+               aVoices[i].mVoice->mChannels &&
+             aVoices[i + n].mSamples == aSamplesToRead &&
+             aVoices[i + n].mLead == 0) {
+        n++;
       }
-      break;
+    }
+    unsigned int samples = aVoices[i].mSamples + aVoices[i].mTail;
+    switch (n) {
+      case 1:
+        mixDirectBatch<1>(aVoices + i, aBuffer, samples, aSamplesToRead,
+          aBufferSize, aChannels);
+        break;
+      case 2:
+        mixDirectBatch<2>(aVoices + i, aBuffer, samples, aSamplesToRead,
+          aBufferSize, aChannels);
+        break;
+      case 3:
+        mixDirectBatch<3>(aVoices + i, aBuffer, samples, aSamplesToRead,
+          aBufferSize, aChannels);
+        break;
+      default:
+        mixDirectBatch<4>(aVoices + i, aBuffer, samples, aSamplesToRead,
+          aBufferSize, aChannels);
+        break;
+    }
+    i += n;
   }
+}
 
-  for (k = 0; k < aChannels; k++) {
-    aVoice->mCurrentChannelVolume[k] = pand[k];
+// Accumulate the voice's post-fader signal into its return busses, ramping
+// the volume the same way panAndExpand is about to. Sends are only taken
+// where the voice is mixed into the whole output buffer at the output rate.
+static void mixSends(Soloud* aSoloud, AudioSourceInstance* aVoice,
+  unsigned int aSamplesToRead, unsigned int aBufferSize, float* aScratch,
+  unsigned int aChannels, ChannelMixFunction aMix) {
+  unsigned int i, k;
+  for (i = 0; i < SENDS_PER_VOICE; i++) {
+    if (aVoice->mSendBus[i] == 0 || aVoice->mSendVolume[i] == 0) {
+      continue;
+    }
+    int ret = aSoloud->getVoiceFromHandle_internal(aVoice->mSendBus[i]);
+    if (ret < 0 ||
+        !(aSoloud->mVoice[ret]->mFlags & AudioSourceInstance::BUS)) {
+      continue;
+    }
+    BusInstance* bus = (BusInstance*)aSoloud->mVoice[ret];
+    if (bus->mChannels != aChannels || !bus->mSendBuffer.mData) {
+      continue;
+    }
+    float pan[MAX_CHANNELS];
+    float pani[MAX_CHANNELS];
+    float gain = aVoice->mSendVolume[i];
+    for (k = 0; k < aChannels; k++) {
+      pan[k] = aVoice->mCurrentChannelVolume[k] * gain;
+      pani[k] =
+        (aVoice->mChannelVolume[k] * aVoice->mOverallVolume * gain - pan[k]) /
+        aSamplesToRead;
+    }
+    float* dst =
+      bus->getSendTarget(aSoloud->mMixCount, aSamplesToRead, aBufferSize);
+    aMix(aScratch, dst, aSamplesToRead, aBufferSize, pan, pani,
+      aVoice->mChannels, aChannels);
   }
 }
 
-void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
+bool Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
   unsigned int aBufferSize, float* aScratch, unsigned int aBus,
   float aSamplerate, unsigned int aChannels, unsigned int aResampler) {
   unsigned int i, j;
+  bool mixed = false;
   // Clear accumulation buffer
-  for (i = 0; i < aSamplesToRead; i++) {
-    for (j = 0; j < aChannels; j++) {
-      aBuffer[i + j * aBufferSize] = 0;
-    }
+  for (j = 0; j < aChannels; j++) {
+    memset(aBuffer + j * aBufferSize, 0, sizeof(float) * aSamplesToRead);
+  }
+
+  // Governor reductions: unprotected voices resample more cheaply, and
+  // optional filters may be skipped.
+  unsigned int lowresampler = aResampler;
+  if (mGovernorLevel >= GOVERNOR_POINT_RESAMPLER) {
+    lowresampler = RESAMPLER_POINT;
+  } else if (mGovernorLevel >= GOVERNOR_LINEAR_RESAMPLER &&
+             lowresampler > RESAMPLER_LINEAR) {
+    lowresampler = RESAMPLER_LINEAR;
   }
+  unsigned int skipmask =
+    mGovernorLevel >= GOVERNOR_SKIP_OPTIONAL_FILTERS ? ~0u : 0;
+
+  DirectVoice directvoice[DIRECT_VOICES];
+  unsigned int directcount = 0;
 
   // Accumulate sound sources
   for (i = 0; i < mActiveVoiceCount; i++) {
@@ -1273,13 +1513,69 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
     if (voice && voice->mBusHandle == aBus &&
         !(voice->mFlags & AudioSourceInstance::PAUSED) &&
         !(voice->mFlags & AudioSourceInstance::INAUDIBLE)) {
-      float step = voice->mSamplerate / aSamplerate;
+      SOLOUD_RT_SCOPE(*voice);
+      float samplerate = voice->mSamplerate;
+      if (voice->mFlags & AudioSourceInstance::BUS) {
+        samplerate = ((BusInstance*)voice)->getMixSamplerate();
+      }
+      unsigned int skipfilters = voice->mOptionalFilters & skipmask;
+      float step = samplerate / aSamplerate;
       // avoid step overflow
       if (step > (1 << (32 - FIXPOINT_FRAC_BITS))) {
         step = 0;
       }
       unsigned int step_fixed = (int)floor(step * FIXPOINT_FRAC_MUL);
+
+      if (directcount < DIRECT_VOICES && step_fixed == FIXPOINT_FRAC_MUL &&
+          canMixDirect(voice, skipfilters,
+            voice->mFlags & AudioSourceInstance::PROTECTED ? aResampler
+                                                           : lowresampler,
+            aSamplesToRead, directvoice[directcount])) {
+        directvoice[directcount].mSlot = mActiveVoice[i];
+        directcount++;
+        continue;
+      }
+
       unsigned int outofs = 0;
+      bool audible = false;
+
+      // Pick the kernels for this voice's layout once, not per chunk.
+      ResampleFunction resample = resampleFunction(
+        voice->mFlags & AudioSourceInstance::PROTECTED ? aResampler
+                                                       : lowresampler,
+        voice->mChannels);
+      ChannelMixFunction mix = channelMixFunction(voice->mChannels, aChannels);
+
+      // A bus running at our rate can mix its children straight into the
+      // scratch, skipping the granularity-sized block and the resampler.
+      bool direct = (voice->mFlags & AudioSourceInstance::BUS) &&
+                    step_fixed == FIXPOINT_FRAC_MUL &&
+                    voice->mDelaySamples == 0 &&
+                    aBufferSize <= ((BusInstance*)voice)->mScratchSize;
+      if (direct) {
+        voice->mLeftoverSamples = 0;
+        voice->mSrcOffset = 0;
+        voice->getAudio(aScratch, aSamplesToRead, aBufferSize);
+
+        bool silent = isBlockSilent(
+          aScratch, aSamplesToRead, aBufferSize, voice->mChannels);
+        bool filtered = false;
+        for (j = 0; j < FILTERS_PER_STREAM; j++) {
+          if (voice->mFilter[j] && !(skipfilters & (1 << j)) &&
+              (!silent || voice->mFilter[j]->hasTail())) {
+            SOLOUD_RT_SCOPE(*voice->mFilter[j]);
+            voice->mFilter[j]->filter(aScratch, aSamplesToRead, aBufferSize,
+              voice->mChannels, samplerate, mStreamTime);
+            filtered = true;
+          }
+        }
+        if (silent && filtered) {
+          silent = isBlockSilent(
+            aScratch, aSamplesToRead, aBufferSize, voice->mChannels);
+        }
+        audible = !silent;
+        outofs = aSamplesToRead;
+      }
 
       if (voice->mDelaySamples) {
         if (voice->mDelaySamples > aSamplesToRead) {
@@ -1303,6 +1599,7 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
           float* t = voice->mResampleData[0];
           voice->mResampleData[0] = voice->mResampleData[1];
           voice->mResampleData[1] = t;
+          voice->mResampleSilence = (voice->mResampleSilence << 1) & 2;
 
           // Get a block of source data
 
@@ -1313,8 +1610,9 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
               voice->mResampleData[0], SAMPLE_GRANULARITY, SAMPLE_GRANULARITY);
             if (readcount < SAMPLE_GRANULARITY) {
               if (voice->mFlags & AudioSourceInstance::LOOPING) {
+                syncVoicePosition_internal(mActiveVoice[i]);
                 while (readcount < SAMPLE_GRANULARITY &&
-                       voice->seek(voice->mLoopPoint, mScratch.mData,
+                       voice->seek(voice->mLoopPoint, mSeekScratch.mData,
                          mScratchSize) == SO_NO_ERROR) {
                   voice->mLoopCount++;
                   int inc = voice->getAudio(voice->mResampleData[0] + readcount,
@@ -1347,15 +1645,31 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
             voice->mSrcOffset -= SAMPLE_GRANULARITY * FIXPOINT_FRAC_MUL;
           }
 
-          // Run the per-stream filters to get our source data
+          // Run the per-stream filters to get our source data. Silent blocks
+          // only need to go through filters that can ring on their own.
 
+          bool silent = readcount == 0 ||
+                        isBlockSilent(voice->mResampleData[0],
+                          SAMPLE_GRANULARITY, SAMPLE_GRANULARITY,
+                          voice->mChannels);
+          bool filtered = false;
           for (j = 0; j < FILTERS_PER_STREAM; j++) {
-            if (voice->mFilter[j]) {
+            if (voice->mFilter[j] && !(skipfilters & (1 << j)) &&
+                (!silent || voice->mFilter[j]->hasTail())) {
+              SOLOUD_RT_SCOPE(*voice->mFilter[j]);
               voice->mFilter[j]->filter(voice->mResampleData[0],
                 SAMPLE_GRANULARITY, SAMPLE_GRANULARITY, voice->mChannels,
-                voice->mSamplerate, mStreamTime);
+                samplerate, mStreamTime);
+              filtered = true;
             }
           }
+          if (silent && filtered) {
+            silent = isBlockSilent(voice->mResampleData[0], SAMPLE_GRANULARITY,
+              SAMPLE_GRANULARITY, voice->mChannels);
+          }
+          if (silent) {
+            voice->mResampleSilence |= 1;
+          }
         } else {
           voice->mLeftoverSamples = 0;
         }
@@ -1384,42 +1698,18 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
           writesamples = aSamplesToRead - outofs;
         }
 
-        // Call resampler to generate the samples, once per channel
-        if (writesamples) {
+        // Call resampler to generate the samples for all channels. If both
+        // blocks the resampler may read from are silent, just clear instead.
+        if (writesamples && (voice->mResampleSilence & 3) == 3) {
           for (j = 0; j < voice->mChannels; j++) {
-            switch (aResampler) {
-              case RESAMPLER_POINT:
-                resample_point(voice->mResampleData[0] + SAMPLE_GRANULARITY * j,
-                  voice->mResampleData[1] + SAMPLE_GRANULARITY * j,
-                  aScratch + aBufferSize * j + outofs, voice->mSrcOffset,
-                  writesamples,
-                  /*voice->mSamplerate,
-                  aSamplerate,*/
-                  step_fixed);
-                break;
-              case RESAMPLER_CATMULLROM:
-                resample_catmullrom(
-                  voice->mResampleData[0] + SAMPLE_GRANULARITY * j,
-                  voice->mResampleData[1] + SAMPLE_GRANULARITY * j,
-                  aScratch + aBufferSize * j + outofs, voice->mSrcOffset,
-                  writesamples,
-                  /*voice->mSamplerate,
-                  aSamplerate,*/
-                  step_fixed);
-                break;
-              default:
-                // case RESAMPLER_LINEAR:
-                resample_linear(
-                  voice->mResampleData[0] + SAMPLE_GRANULARITY * j,
-                  voice->mResampleData[1] + SAMPLE_GRANULARITY * j,
-                  aScratch + aBufferSize * j + outofs, voice->mSrcOffset,
-                  writesamples,
-                  /*voice->mSamplerate,
-                  aSamplerate,*/
-                  step_fixed);
-                break;
-            }
+            memset(aScratch + aBufferSize * j + outofs, 0,
+              sizeof(float) * writesamples);
           }
+        } else if (writesamples) {
+          audible = true;
+          resample(voice->mResampleData[0], voice->mResampleData[1],
+            aScratch + outofs, aBufferSize, voice->mChannels, voice->mSrcOffset,
+            writesamples, step_fixed);
         }
 
         // Keep track of how many samples we've written so far
@@ -1429,9 +1719,24 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
         voice->mSrcOffset += writesamples * step_fixed;
       }
 
-      // Handle panning and channel expansion (and/or shrinking)
-      panAndExpand(
-        voice, aBuffer, aSamplesToRead, aBufferSize, aScratch, aChannels);
+      // Handle panning and channel expansion (and/or shrinking). Silent
+      // voices have nothing to accumulate; only settle their volume ramp.
+      if (audible) {
+        if ((voice->mFlags & AudioSourceInstance::HAS_SENDS) &&
+            aSamplerate == (float)mSamplerate &&
+            aSamplesToRead == mMixSamples) {
+          mixSends(this, voice, aSamplesToRead, aBufferSize, aScratch,
+            aChannels, mix);
+        }
+        panAndExpand(voice, aBuffer, aSamplesToRead, aBufferSize, aScratch,
+          aChannels, mix);
+        mixed = true;
+      } else {
+        for (j = 0; j < aChannels; j++) {
+          voice->mCurrentChannelVolume[j] =
+            voice->mChannelVolume[j] * voice->mOverallVolume;
+        }
+      }
 
       // clear voice if the sound is over
       if (!(voice->mFlags & (AudioSourceInstance::LOOPING |
@@ -1445,7 +1750,12 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
                (voice->mFlags & AudioSourceInstance::INAUDIBLE_TICK)) {
       // Inaudible but needs ticking. Do minimal work (keep counters up to date
       // and ask audiosource for data)
-      float step = voice->mSamplerate / aSamplerate;
+      SOLOUD_RT_SCOPE(*voice);
+      float samplerate = voice->mSamplerate;
+      if (voice->mFlags & AudioSourceInstance::BUS) {
+        samplerate = ((BusInstance*)voice)->getMixSamplerate();
+      }
+      float step = samplerate / aSamplerate;
       int step_fixed = (int)floor(step * FIXPOINT_FRAC_MUL);
       unsigned int outofs = 0;
 
@@ -1475,8 +1785,9 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
               voice->mResampleData[0], SAMPLE_GRANULARITY, SAMPLE_GRANULARITY);
             if (readcount < SAMPLE_GRANULARITY) {
               if (voice->mFlags & AudioSourceInstance::LOOPING) {
+                syncVoicePosition_internal(mActiveVoice[i]);
                 while (readcount < SAMPLE_GRANULARITY &&
-                       voice->seek(voice->mLoopPoint, mScratch.mData,
+                       voice->seek(voice->mLoopPoint, mSeekScratch.mData,
                          mScratchSize) == SO_NO_ERROR) {
                   voice->mLoopCount++;
                   readcount +=
@@ -1541,6 +1852,22 @@ void Soloud::mixBus_internal(float* aBuffer, unsigned int aSamplesToRead,
       }
     }
   }
+
+  if (directcount) {
+    mDirectVoices += directcount;
+    mixDirect(directvoice, directcount, aBuffer, aSamplesToRead, aBufferSize,
+      aChannels);
+    mixed = true;
+    for (i = 0; i < directcount; i++) {
+      AudioSourceInstance* voice = directvoice[i].mVoice;
+      if (!(voice->mFlags & (AudioSourceInstance::LOOPING |
+                              AudioSourceInstance::DISABLE_AUTOSTOP)) &&
+          voice->hasEnded()) {
+        stopVoice_internal(directvoice[i].mSlot);
+      }
+    }
+  }
+  return mixed;
 }
 
 void Soloud::mapResampleBuffers_internal() {
@@ -1589,30 +1916,95 @@ void Soloud::mapResampleBuffers_internal() {
         sizeof(float) * SAMPLE_GRANULARITY * MAX_CHANNELS);
       memset(mResampleDataOwner[found]->mResampleData[1], 0,
         sizeof(float) * SAMPLE_GRANULARITY * MAX_CHANNELS);
+      mResampleDataOwner[found]->mResampleSilence = 3;
       latestfree = found + 1;
     }
   }
 }
 
+unsigned int Soloud::getActiveVoiceLimit_internal() const {
+  if (mGovernorLevel < GOVERNOR_LIMIT_VOICES) {
+    return mMaxActiveVoices;
+  }
+  unsigned int limit = mGovernorVoiceLimit;
+  if (limit == 0) {
+    limit = mMaxActiveVoices / 2;
+  }
+  if (limit < 1) {
+    limit = 1;
+  }
+  return limit < mMaxActiveVoices ? limit : mMaxActiveVoices;
+}
+
+void Soloud::updateGovernor_internal(float aLoad) {
+  mMixLoadSnapshot.store(aLoad, std::memory_order_release);
+  bool enabled = mGovernorEnabled.load(std::memory_order_relaxed);
+  if (!enabled && mGovernorLevel == GOVERNOR_FULL) {
+    return;
+  }
+
+  unsigned int maxlevel = mGovernorMaxLevel.load(std::memory_order_relaxed);
+  unsigned int level = mGovernorLevel;
+  if (!enabled) {
+    level = GOVERNOR_FULL;
+  } else if (aLoad > mGovernorHighLoad.load(std::memory_order_relaxed)) {
+    // Step down right away; each overrun buffer costs another level.
+    mGovernorCalmBuffers = 0;
+    if (level < maxlevel) {
+      level++;
+    }
+  } else if (aLoad < mGovernorLowLoad.load(std::memory_order_relaxed)) {
+    // Only climb back after a run of calm buffers, so we don't oscillate.
+    mGovernorCalmBuffers++;
+    if (level > GOVERNOR_FULL &&
+        mGovernorCalmBuffers >=
+          mGovernorHoldBuffers.load(std::memory_order_relaxed)) {
+      level--;
+      mGovernorCalmBuffers = 0;
+    }
+  } else {
+    mGovernorCalmBuffers = 0;
+  }
+  if (level > maxlevel) {
+    level = maxlevel;
+  }
+  if (level == mGovernorLevel) {
+    return;
+  }
+
+  // The mix and the active voice count read the level under the mutex
+  lockAudioMutex_internal();
+  mGovernorLevel = level;
+  mGovernorLevelSnapshot.store(level, std::memory_order_release);
+  mActiveVoiceDirty = true;
+  governorCallback callback = mGovernorCallback;
+  void* userdata = mGovernorUserData;
+  unlockAudioMutex_internal();
+
+  if (callback) {
+    callback(level, aLoad, userdata);
+  }
+}
+
 void Soloud::calcActiveVoices_internal() {
   // TODO: consider whether we need to re-evaluate the active voices all the
   // time. It is a must when new voices are started, but otherwise we could get
   // away with postponing it sometimes..
 
   mActiveVoiceDirty = false;
+  unsigned int maxvoices = getActiveVoiceLimit_internal();
 
   // Populate
   unsigned int i, candidates, mustlive;
   candidates = 0;
   mustlive = 0;
   for (i = 0; i < mHighestVoice; i++) {
-    if (mVoice[i] &&
-        (!(mVoice[i]->mFlags &
-           (AudioSourceInstance::INAUDIBLE | AudioSourceInstance::PAUSED)) ||
-          (mVoice[i]->mFlags & AudioSourceInstance::INAUDIBLE_TICK))) {
+    unsigned char state = mVoiceState[i];
+    if ((state & (VOICE_ALIVE | VOICE_SEEKING)) == VOICE_ALIVE &&
+        (!(state & (VOICE_INAUDIBLE | VOICE_PAUSED)) || (state & VOICE_TICK))) {
       mActiveVoice[candidates] = i;
       candidates++;
-      if (mVoice[i]->mFlags & AudioSourceInstance::INAUDIBLE_TICK) {
+      if (state & VOICE_TICK) {
         mActiveVoice[candidates - 1] = mActiveVoice[mustlive];
         mActiveVoice[mustlive] = i;
         mustlive++;
@@ -1621,16 +2013,16 @@ void Soloud::calcActiveVoices_internal() {
   }
 
   // Check for early out
-  if (candidates <= mMaxActiveVoices) {
+  if (candidates <= maxvoices) {
     // everything is audible, early out
     mActiveVoiceCount = candidates;
     mapResampleBuffers_internal();
     return;
   }
 
-  mActiveVoiceCount = mMaxActiveVoices;
+  mActiveVoiceCount = maxvoices;
 
-  if (mustlive >= mMaxActiveVoices) {
+  if (mustlive >= maxvoices) {
     // Oopsie. Well, nothing to sort, since the "must live" voices already
     // ate all our active voice slots.
     // This is a potentially an error situation, but we have no way to report
@@ -1652,15 +2044,15 @@ void Soloud::calcActiveVoices_internal() {
         len = stack[pos = 0];
       }
       int pivot = data[left];
-      float pivotvol = mVoice[pivot]->mOverallVolume;
+      float pivotvol = mVoiceVolume[pivot];
       stack[pos++] = len;
       for (right = left - 1;;) {
         do {
           right++;
-        } while (mVoice[data[right]]->mOverallVolume > pivotvol);
+        } while (mVoiceVolume[data[right]] > pivotvol);
         do {
           len--;
-        } while (pivotvol > mVoice[data[len]]->mOverallVolume);
+        } while (pivotvol > mVoiceVolume[data[len]]);
         if (right >= len) {
           break;
         }
@@ -1682,6 +2074,14 @@ void Soloud::calcActiveVoices_internal() {
   mapResampleBuffers_internal();
 }
 
+// Time spent mixing since aStart, relative to the duration of the buffer
+static float mixLoad(
+  std::chrono::steady_clock::time_point aStart, float aBufferTime) {
+  std::chrono::duration<float> elapsed =
+    std::chrono::steady_clock::now() - aStart;
+  return aBufferTime > 0 ? elapsed.count() / aBufferTime : 0;
+}
+
 void Soloud::mix_internal(unsigned int aSamples, unsigned int aStride) {
 #ifdef FLOATING_POINT_DEBUG
   // This needs to be done in the audio thread as well..
@@ -1735,8 +2135,14 @@ void Soloud::mix_internal(unsigned int aSamples, unsigned int aStride) {
   }
 #endif
 
+  SOLOUD_RT_ENTER_MIXER();
+  std::chrono::steady_clock::time_point mixstart =
+    std::chrono::steady_clock::now();
   float buffertime = aSamples / (float)mSamplerate;
   float globalVolume[2];
+  mMixCount++;
+  mMixSamples = aSamples;
+  mDirectVoices = 0;
   mStreamTime += buffertime;
   mLastClockedTime = 0;
 
@@ -1748,78 +2154,138 @@ void Soloud::mix_internal(unsigned int aSamples, unsigned int aStride) {
 
   lockAudioMutex_internal();
 
-  // Process faders. May change scratch size.
+  // Drop trailing empty voice slots so idle engines don't walk them every
+  // buffer.
+  while (mHighestVoice > 0 && mVoice[mHighestVoice - 1] == NULL) {
+    mHighestVoice--;
+  }
+
+  // Process faders. May change scratch size. The common case (running voice,
+  // nothing fading) only touches the per-slot arrays; the voice instance is
+  // visited just for voices that have a fader or scheduler going.
   int i;
   for (i = 0; i < (signed)mHighestVoice; i++) {
-    if (mVoice[i] && !(mVoice[i]->mFlags & AudioSourceInstance::PAUSED)) {
-      float volume[2];
+    unsigned char state = mVoiceState[i];
+    if ((state & (VOICE_ALIVE | VOICE_PAUSED | VOICE_SEEKING)) != VOICE_ALIVE) {
+      continue;
+    }
 
-      mVoice[i]->mActiveFader = 0;
+    mVoiceStreamTime[i] += buffertime;
+    mVoicePositionDelta[i] += (double)buffertime * (double)mVoiceSpeed[i];
 
-      if (mGlobalVolumeFader.mActive > 0) {
-        mVoice[i]->mActiveFader = 1;
-      }
+    if (!(state & VOICE_FADING)) {
+      continue;
+    }
 
-      mVoice[i]->mStreamTime += buffertime;
-      mVoice[i]->mStreamPosition +=
-        (double)buffertime * (double)mVoice[i]->mOverallRelativePlaySpeed;
+    AudioSourceInstance* voice = mVoice[i];
+    time streamtime = mVoiceStreamTime[i];
 
-      // TODO: this is actually unstable, because mStreamTime depends on the
-      // relative play speed.
-      if (mVoice[i]->mRelativePlaySpeedFader.mActive > 0) {
-        float speed =
-          mVoice[i]->mRelativePlaySpeedFader.get(mVoice[i]->mStreamTime);
-        setVoiceRelativePlaySpeed_internal(i, speed);
-      }
+    // TODO: this is actually unstable, because mStreamTime depends on the
+    // relative play speed.
+    if (voice->mRelativePlaySpeedFader.mActive > 0) {
+      float speed = voice->mRelativePlaySpeedFader.get(streamtime);
+      setVoiceRelativePlaySpeed_internal(i, speed);
+    }
 
-      volume[0] = mVoice[i]->mOverallVolume;
-      if (mVoice[i]->mVolumeFader.mActive > 0) {
-        mVoice[i]->mSetVolume =
-          mVoice[i]->mVolumeFader.get(mVoice[i]->mStreamTime);
-        mVoice[i]->mActiveFader = 1;
-        updateVoiceVolume_internal(i);
-        mActiveVoiceDirty = true;
-      }
-      volume[1] = mVoice[i]->mOverallVolume;
+    if (voice->mVolumeFader.mActive > 0) {
+      voice->mSetVolume = voice->mVolumeFader.get(streamtime);
+      updateVoiceVolume_internal(i);
+      mActiveVoiceDirty = true;
+    }
 
-      if (mVoice[i]->mPanFader.mActive > 0) {
-        float pan = mVoice[i]->mPanFader.get(mVoice[i]->mStreamTime);
-        setVoicePan_internal(i, pan);
-        mVoice[i]->mActiveFader = 1;
-      }
+    if (voice->mPanFader.mActive > 0) {
+      float pan = voice->mPanFader.get(streamtime);
+      setVoicePan_internal(i, pan);
+    }
 
-      if (mVoice[i]->mPauseScheduler.mActive) {
-        mVoice[i]->mPauseScheduler.get(mVoice[i]->mStreamTime);
-        if (mVoice[i]->mPauseScheduler.mActive == -1) {
-          mVoice[i]->mPauseScheduler.mActive = 0;
-          setVoicePause_internal(i, 1);
-        }
+    if (voice->mPauseScheduler.mActive) {
+      voice->mPauseScheduler.get(streamtime);
+      if (voice->mPauseScheduler.mActive == -1) {
+        voice->mPauseScheduler.mActive = 0;
+        setVoicePause_internal(i, 1);
       }
+    }
 
-      if (mVoice[i]->mStopScheduler.mActive) {
-        mVoice[i]->mStopScheduler.get(mVoice[i]->mStreamTime);
-        if (mVoice[i]->mStopScheduler.mActive == -1) {
-          mVoice[i]->mStopScheduler.mActive = 0;
-          stopVoice_internal(i);
-        }
+    if (voice->mStopScheduler.mActive) {
+      voice->mStopScheduler.get(streamtime);
+      if (voice->mStopScheduler.mActive == -1) {
+        voice->mStopScheduler.mActive = 0;
+        stopVoice_internal(i);
+        continue;
       }
     }
+
+    // Drop the fading bit once every fader has run its course.
+    updateVoiceState_internal(i);
   }
 
   if (mActiveVoiceDirty) {
     calcActiveVoices_internal();
   }
 
+  // Idle short-circuit: with nothing playing the output is silence, unless a
+  // global filter is still ringing out. Filters are given time to decay below
+  // the silence threshold before we stop running them.
+  bool hasGlobalFilters = false;
+  for (i = 0; i < FILTERS_PER_STREAM; i++) {
+    if (mFilterInstance[i]) {
+      hasGlobalFilters = true;
+    }
+  }
+  if (mActiveVoiceCount != 0) {
+    mSilentSamples = 0;
+  }
+  mIdle = mActiveVoiceCount == 0 &&
+          (!hasGlobalFilters ||
+            mSilentSamples >= SOLOUD_IDLE_FILTER_TAIL * mSamplerate);
+  mIdleSnapshot.store(mIdle, std::memory_order_release);
+  if (mIdle) {
+    publishVoices_internal();
+    mDirectVoiceCountSnapshot.store(0, std::memory_order_release);
+    unlockAudioMutex_internal();
+    if (mFlags & ENABLE_VISUALIZATION) {
+      memset(mVisualizationChannelVolume, 0, sizeof(float) * MAX_CHANNELS);
+      memset(mVisualizationWaveData, 0, sizeof(float) * 256);
+    }
+    SOLOUD_RT_LEAVE_MIXER();
+    updateGovernor_internal(mixLoad(mixstart, buffertime));
+    return;
+  }
+
   mixBus_internal(mOutputScratch.mData, aSamples, aStride, mScratch.mData, 0,
     (float)mSamplerate, mChannels, mResampler);
 
   for (i = 0; i < FILTERS_PER_STREAM; i++) {
     if (mFilterInstance[i]) {
+      SOLOUD_RT_SCOPE(*mFilterInstance[i]);
       mFilterInstance[i]->filter(mOutputScratch.mData, aSamples, aStride,
         mChannels, (float)mSamplerate, mStreamTime);
     }
   }
 
+  if (mActiveVoiceCount == 0) {
+    // Only the global filter tails are left; track how long they've been
+    // quiet.
+    float peak = 0;
+    unsigned int j;
+    for (j = 0; j < mChannels; j++) {
+      unsigned int k;
+      for (k = 0; k < aSamples; k++) {
+        float f = (float)fabs(mOutputScratch.mData[k + j * aStride]);
+        if (f > peak) {
+          peak = f;
+        }
+      }
+    }
+    if (peak < SOLOUD_SILENCE_THRESHOLD) {
+      mSilentSamples += aSamples;
+    } else {
+      mSilentSamples = 0;
+    }
+  }
+
+  publishVoices_internal();
+  mDirectVoiceCountSnapshot.store(mDirectVoices, std::memory_order_release);
   unlockAudioMutex_internal();
 
   // Note: clipping channels*aStride, not channels*aSamples, so we're possibly
@@ -1861,17 +2327,27 @@ void Soloud::mix_internal(unsigned int aSamples, unsigned int aStride) {
       }
     }
   }
+  SOLOUD_RT_LEAVE_MIXER();
+  updateGovernor_internal(mixLoad(mixstart, buffertime));
 }
 
 void Soloud::mix(float* aBuffer, unsigned int aSamples) {
   unsigned int stride = (aSamples + 15) & ~0xf;
   mix_internal(aSamples, stride);
+  if (mIdle) {
+    memset(aBuffer, 0, sizeof(float) * aSamples * mChannels);
+    return;
+  }
   interlace_samples_float(mScratch.mData, aBuffer, aSamples, mChannels, stride);
 }
 
 void Soloud::mixSigned16(short* aBuffer, unsigned int aSamples) {
   unsigned int stride = (aSamples + 15) & ~0xf;
   mix_internal(aSamples, stride);
+  if (mIdle) {
+    memset(aBuffer, 0, sizeof(short) * aSamples * mChannels);
+    return;
+  }
   interlace_samples_s16(mScratch.mData, aBuffer, aSamples, mChannels, stride);
 }
 
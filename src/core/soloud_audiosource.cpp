@@ -76,23 +76,30 @@ AudioSourceInstance::AudioSourceInstance() {
   mBaseSamplerate = 44100.0f;
   mSamplerate = 44100.0f;
   mSetRelativePlaySpeed = 1.0f;
-  mStreamTime = 0.0f;
   mStreamPosition = 0.0f;
   mAudioSourceID = 0;
-  mActiveFader = 0;
   mChannels = 1;
   mBusHandle = ~0u;
   mLoopCount = 0;
   mLoopPoint = 0;
+  mPendingSeek = -1;
+  mPendingBaseSamplerate = -1;
+  mPendingLoopPoint = -1;
   for (i = 0; i < FILTERS_PER_STREAM; i++) {
     mFilter[i] = NULL;
   }
+  mOptionalFilters = 0;
+  for (i = 0; i < SENDS_PER_VOICE; i++) {
+    mSendBus[i] = 0;
+    mSendVolume[i] = 0;
+  }
   for (i = 0; i < MAX_CHANNELS; i++) {
     mCurrentChannelVolume[i] = 0;
   }
   // behind pointers because we swap between the two buffers
   mResampleData[0] = 0;
   mResampleData[1] = 0;
+  mResampleSilence = 0;
   mSrcOffset = 0;
   mLeftoverSamples = 0;
   mDelaySamples = 0;
@@ -112,9 +119,9 @@ void AudioSourceInstance::init(AudioSource& aSource, int aPlayIndex) {
   mBaseSamplerate = aSource.mBaseSamplerate;
   mSamplerate = mBaseSamplerate;
   mChannels = aSource.mChannels;
-  mStreamTime = 0.0f;
   mStreamPosition = 0.0f;
   mLoopPoint = aSource.mLoopPoint;
+  mOptionalFilters = aSource.mOptionalFilters;
 
   if (aSource.mFlags & AudioSource::SHOULD_LOOP) {
     mFlags |= AudioSourceInstance::LOOPING;
@@ -169,10 +176,15 @@ AudioSource::AudioSource() {
   for (i = 0; i < FILTERS_PER_STREAM; i++) {
     mFilter[i] = 0;
   }
+  mOptionalFilters = 0;
   mFlags = 0;
   mBaseSamplerate = 44100;
   mAudioSourceID = 0;
   mSoloud = 0;
+  mFirstVoice = -1;
+  mVoiceListOwner = NULL;
+  mVirtualVoices = 0;
+  mPendingSeeks = 0;
   mChannels = 1;
   m3dMinDistance = 1;
   m3dMaxDistance = 1000000.0f;
@@ -233,6 +245,21 @@ void AudioSource::setFilter(unsigned int aFilterId, Filter* aFilter) {
   mFilter[aFilterId] = aFilter;
 }
 
+void AudioSource::setFilterOptional(unsigned int aFilterId, bool aOptional) {
+  if (aFilterId >= FILTERS_PER_STREAM) {
+    return;
+  }
+  if (aOptional) {
+    mOptionalFilters |= 1 << aFilterId;
+  } else {
+    mOptionalFilters &= ~(1 << aFilterId);
+  }
+}
+
+time AudioSource::getLength() {
+  return 0;
+}
+
 void AudioSource::stop() {
   if (mSoloud) {
     mSoloud->stopAudioSource(*this);
@@ -293,4 +320,12 @@ float AudioSourceInstance::getInfo(unsigned int /*aInfoKey*/) {
   return 0;
 }
 
+const float* AudioSourceInstance::getDirectData(unsigned int& /*aSamples*/,
+  unsigned int& /*aHistory*/, unsigned int& /*aChannelStride*/) {
+  return NULL;
+}
+
+void AudioSourceInstance::skipDirectData(unsigned int /*aSamples*/) {
+}
+
 };  // namespace SoLoud
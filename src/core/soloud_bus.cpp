@@ -22,6 +22,8 @@ freely, subject to the following restrictions:
    distribution.
 */
 
+#include <string.h>
+
 #include "soloud.h"
 #include "soloud_fft.h"
 #include "soloud_internal.h"
@@ -29,15 +31,88 @@ freely, subject to the following restrictions:
 namespace SoLoud {
 BusInstance::BusInstance(Bus* aParent) {
   mParent = aParent;
-  mFlags |= PROTECTED | INAUDIBLE_TICK;
+  mFlags |= PROTECTED | INAUDIBLE_TICK | BUS;
   for (int i = 0; i < MAX_CHANNELS; i++) {
     mVisualizationChannelVolume[i] = 0;
   }
   for (int i = 0; i < 256; i++) {
     mVisualizationWaveData[i] = 0;
   }
+  // Large enough for the parent's whole buffer, so the bus can be mixed
+  // directly into it without going through the resampler.
   mScratchSize = SAMPLE_GRANULARITY;
+  if (aParent->mSoloud && aParent->mSoloud->mScratchSize > mScratchSize) {
+    mScratchSize = aParent->mSoloud->mScratchSize;
+  }
   mScratch.init(mScratchSize * MAX_CHANNELS);
+  for (int i = 0; i < 2; i++) {
+    mSendMix[i] = 0;
+    mSendSamples[i] = 0;
+    mSendStride[i] = 0;
+  }
+  mSendReadMix = 0;
+  mSendReadOffset = 0;
+}
+
+void BusInstance::initSendBuffer() {
+  if (!mSendBuffer.mData) {
+    mSendBuffer.init(mScratchSize * mChannels * 2);
+  }
+}
+
+float* BusInstance::getSendTarget(
+  unsigned int aMix, unsigned int aSamples, unsigned int aStride) {
+  unsigned int half = aMix & 1;
+  float* data = mSendBuffer.mData + half * mScratchSize * mChannels;
+  if (mSendMix[half] != aMix) {
+    mSendMix[half] = aMix;
+    mSendSamples[half] = aSamples;
+    mSendStride[half] = aStride;
+    memset(data, 0, sizeof(float) * aStride * mChannels);
+  }
+  return data;
+}
+
+bool BusInstance::readSends(
+  float* aBuffer, unsigned int aSamplesToRead, unsigned int aBufferSize) {
+  Soloud* s = mParent->mSoloud;
+  if (!mSendBuffer.mData || getMixSamplerate() != (float)s->mSamplerate) {
+    return false;
+  }
+  unsigned int mix = s->mMixCount - 1;
+  unsigned int half = mix & 1;
+  if (mSendMix[half] != mix) {
+    return false;
+  }
+  if (mSendReadMix != mix) {
+    mSendReadMix = mix;
+    mSendReadOffset = 0;
+  }
+  unsigned int count = mSendSamples[half] - mSendReadOffset;
+  if (count > aSamplesToRead) {
+    count = aSamplesToRead;
+  }
+  if (count == 0) {
+    return false;
+  }
+  const float* src = mSendBuffer.mData + half * mScratchSize * mChannels +
+                     mSendReadOffset;
+  unsigned int i, j;
+  for (j = 0; j < mChannels; j++) {
+    for (i = 0; i < count; i++) {
+      aBuffer[i + j * aBufferSize] += src[i + j * mSendStride[half]];
+    }
+  }
+  mSendReadOffset += count;
+  return true;
+}
+
+float BusInstance::getMixSamplerate() const {
+  if (mParent->mInternalSamplerate > 0 &&
+      mParent->mSoloud->mGovernorLevel >= Soloud::GOVERNOR_HALVE_BUS_RATE) {
+    return mSamplerate * 0.5f;
+  }
+  return mSamplerate;
 }
 
 unsigned int BusInstance::getAudio(
@@ -49,15 +124,33 @@ unsigned int BusInstance::getAudio(
     for (i = 0; i < aBufferSize * mChannels; i++) {
       aBuffer[i] = 0;
     }
+    readSends(aBuffer, aSamplesToRead, aBufferSize);
     return aSamplesToRead;
   }
 
   Soloud* s = mParent->mSoloud;
 
-  s->mixBus_internal(aBuffer, aSamplesToRead, aBufferSize, mScratch.mData,
-    handle, mSamplerate, mChannels, mParent->mResampler);
+  bool mixed = s->mixBus_internal(aBuffer, aSamplesToRead, aBufferSize,
+    mScratch.mData, handle, getMixSamplerate(), mChannels,
+    mParent->mResampler);
+  if (readSends(aBuffer, aSamplesToRead, aBufferSize)) {
+    mixed = true;
+  }
 
   int i;
+  if (!mixed) {
+    // All inputs were silent and the buffer is already clear.
+    if (mParent->mFlags & AudioSource::VISUALIZATION_DATA) {
+      for (i = 0; i < MAX_CHANNELS; i++) {
+        mVisualizationChannelVolume[i] = 0;
+      }
+      for (i = 0; i < 256; i++) {
+        mVisualizationWaveData[i] = 0;
+      }
+    }
+    return aSamplesToRead;
+  }
+
   if (mParent->mFlags & AudioSource::VISUALIZATION_DATA) {
     for (i = 0; i < MAX_CHANNELS; i++) {
       mVisualizationChannelVolume[i] = 0;
@@ -115,6 +208,7 @@ Bus::Bus() {
   mInstance = 0;
   mChannels = 2;
   mResampler = SOLOUD_DEFAULT_RESAMPLER;
+  mInternalSamplerate = 0;
   for (int i = 0; i < 256; i++) {
     mFFTData[i] = 0;
     mWaveData[i] = 0;
@@ -127,6 +221,13 @@ BusInstance* Bus::createInstance() {
     mChannelHandle = 0;
     mInstance = 0;
   }
+  // Run at the output rate so the bus can skip resampling in its parent,
+  // unless a reduced internal rate was requested.
+  if (mInternalSamplerate > 0) {
+    mBaseSamplerate = mInternalSamplerate;
+  } else if (mSoloud && mSoloud->mSamplerate) {
+    mBaseSamplerate = (float)mSoloud->mSamplerate;
+  }
   mInstance = new BusInstance(this);
   return mInstance;
 }
@@ -134,13 +235,12 @@ BusInstance* Bus::createInstance() {
 void Bus::findBusHandle() {
   if (mChannelHandle == 0) {
     // Find the channel the bus is playing on to calculate handle..
-    int i;
-    for (i = 0; mChannelHandle == 0 && i < (signed)mSoloud->mHighestVoice;
-      i++) {
-      if (mSoloud->mVoice[i] == mInstance) {
-        mChannelHandle = mSoloud->getHandleFromVoice_internal(i);
-      }
+    mSoloud->lockAudioMutex_internal();
+    int ch = mSoloud->findSourceVoice_internal(*this, mInstance);
+    if (ch != -1) {
+      mChannelHandle = mSoloud->getHandleFromVoice_internal(ch);
     }
+    mSoloud->unlockAudioMutex_internal();
   }
 }
 
@@ -231,14 +331,24 @@ void Bus::setFilter(unsigned int aFilterId, Filter* aFilter) {
 }
 
 result Bus::setChannels(unsigned int aChannels) {
-  if (aChannels == 0 || aChannels == 3 || aChannels == 5 || aChannels == 7 ||
-      aChannels > MAX_CHANNELS) {
+  if (!isValidChannelCount(aChannels)) {
     return INVALID_PARAMETER;
   }
   mChannels = aChannels;
   return SO_NO_ERROR;
 }
 
+result Bus::setSamplerate(float aSamplerate) {
+  if (aSamplerate < 0) {
+    return INVALID_PARAMETER;
+  }
+  mInternalSamplerate = aSamplerate;
+  if (aSamplerate > 0) {
+    mBaseSamplerate = aSamplerate;
+  }
+  return SO_NO_ERROR;
+}
+
 void Bus::setVisualizationEnable(bool aEnable) {
   if (aEnable) {
     mFlags |= AudioSource::VISUALIZATION_DATA;
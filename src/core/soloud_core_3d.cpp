@@ -165,6 +165,29 @@ float attenuateExponentialDistance(float aDistance, float aMinDistance,
   return (float)pow(distance / aMinDistance, -aRolloffFactor);
 }
 
+float Soloud::attenuate3d_internal(AudioAttenuator* aAttenuator,
+  unsigned int aModel, float aDistance, float aMinDistance, float aMaxDistance,
+  float aRolloffFactor) {
+  if (aAttenuator) {
+    return aAttenuator->attenuate(
+      aDistance, aMinDistance, aMaxDistance, aRolloffFactor);
+  }
+  switch (aModel) {
+    case AudioSource::INVERSE_DISTANCE:
+      return attenuateInvDistance(
+        aDistance, aMinDistance, aMaxDistance, aRolloffFactor);
+    case AudioSource::LINEAR_DISTANCE:
+      return attenuateLinearDistance(
+        aDistance, aMinDistance, aMaxDistance, aRolloffFactor);
+    case AudioSource::EXPONENTIAL_DISTANCE:
+      return attenuateExponentialDistance(
+        aDistance, aMinDistance, aMaxDistance, aRolloffFactor);
+    default:
+      // case AudioSource::NO_ATTENUATION:
+      return 1;
+  }
+}
+
 void Soloud::update3dVoices_internal(
   unsigned int* aVoiceArray, unsigned int aVoiceCount) {
   vec3 speaker[MAX_CHANNELS];
@@ -229,28 +252,8 @@ void Soloud::update3dVoices_internal(
 
     // attenuation
 
-    if (v->mAttenuator) {
-      vol *= v->mAttenuator->attenuate(
-        dist, v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
-    } else {
-      switch (v->m3dAttenuationModel) {
-        case AudioSource::INVERSE_DISTANCE:
-          vol *= attenuateInvDistance(dist, v->m3dMinDistance,
-            v->m3dMaxDistance, v->m3dAttenuationRolloff);
-          break;
-        case AudioSource::LINEAR_DISTANCE:
-          vol *= attenuateLinearDistance(dist, v->m3dMinDistance,
-            v->m3dMaxDistance, v->m3dAttenuationRolloff);
-          break;
-        case AudioSource::EXPONENTIAL_DISTANCE:
-          vol *= attenuateExponentialDistance(dist, v->m3dMinDistance,
-            v->m3dMaxDistance, v->m3dAttenuationRolloff);
-          break;
-        default:
-          // case AudioSource::NO_ATTENUATION:
-          break;
-      }
-    }
+    vol *= attenuate3d_internal(v->mAttenuator, v->m3dAttenuationModel, dist,
+      v->m3dMinDistance, v->m3dMaxDistance, v->m3dAttenuationRolloff);
 
     // cone
 
@@ -329,6 +332,8 @@ void Soloud::update3dAudio() {
       } else {
         vi->mFlags &= ~AudioSourceInstance::INAUDIBLE;
       }
+      updateVoiceState_internal(voices[i]);
+      publishVoice_internal(voices[i]);
     }
   }
 
@@ -391,6 +396,8 @@ handle Soloud::play3d(AudioSource& aSound, float aPosX, float aPosY,
   } else {
     mVoice[v]->mFlags &= ~AudioSourceInstance::INAUDIBLE;
   }
+  updateVoiceState_internal(v);
+  publishVoice_internal(v);
   mActiveVoiceDirty = true;
 
   unlockAudioMutex_internal();
@@ -461,6 +468,8 @@ handle Soloud::play3dClocked(time aSoundTime, AudioSource& aSound, float aPosX,
   } else {
     mVoice[v]->mFlags &= ~AudioSourceInstance::INAUDIBLE;
   }
+  updateVoiceState_internal(v);
+  publishVoice_internal(v);
   mActiveVoiceDirty = true;
   unlockAudioMutex_internal();
 
@@ -25,6 +25,7 @@ freely, subject to the following restrictions:
 #include <string.h>
 
 #include "soloud_internal.h"
+#include "soloud_thread.h"
 
 // Core "basic" operations - play, stop, etc
 
@@ -58,16 +59,37 @@ handle Soloud::play(AudioSource& aSound, float aVolume, float aPan,
   mVoice[ch]->init(aSound, mPlayIndex);
   m3dData[ch].init(aSound);
 
+  // Play index only orders voices for stealing; handles use the slot's own
+  // generation, which skips 0xffff (top bits full = voice group).
   mPlayIndex++;
+  mVoiceGeneration[ch]++;
+  if (mVoiceGeneration[ch] == 0xffff) {
+    mVoiceGeneration[ch] = 0;
+  }
 
-  // 20 bits, skip the last one (top bits full = voice group)
-  if (mPlayIndex == 0xfffff) {
-    mPlayIndex = 0;
+  VoiceSourceLink& link = mVoiceSourceLink[ch];
+  link.mSource = &aSound;
+  link.mPrev = -1;
+  link.mNext = -1;
+  Soloud* owner = NULL;
+  link.mListed = aSound.mVoiceListOwner.compare_exchange_strong(owner, this) ||
+                 owner == this;
+  if (link.mListed) {
+    link.mNext = aSound.mFirstVoice;
+    if (link.mNext != -1) {
+      mVoiceSourceLink[link.mNext].mPrev = ch;
+    }
+    aSound.mFirstVoice = ch;
+  } else {
+    mUnlistedVoices++;
   }
 
   if (aPaused) {
     mVoice[ch]->mFlags |= AudioSourceInstance::PAUSED;
   }
+  mVoiceStreamTime[ch] = 0;
+  mVoicePositionDelta[ch] = 0;
+  updateVoiceState_internal(ch);
 
   setVoicePan_internal(ch, aPan);
   if (aVolume < 0) {
@@ -92,6 +114,7 @@ handle Soloud::play(AudioSource& aSound, float aVolume, float aPan,
   }
 
   mActiveVoiceDirty = true;
+  publishVoice_internal(ch);
 
   unlockAudioMutex_internal();
 
@@ -131,14 +154,128 @@ result Soloud::seek(handle aVoiceHandle, time aSeconds) {
   result res = SO_NO_ERROR;
   result singleres = SO_NO_ERROR;
   FOR_ALL_VOICES_PRE
-  singleres = mVoice[ch]->seek(aSeconds, mScratch.mData, mScratchSize);
-  if (singleres != SO_NO_ERROR) {
-    res = singleres;
+  if (mVoice[ch]->mFlags & AudioSourceInstance::SEEKING) {
+    // Can't touch the instance; retarget the seek in flight instead.
+    mVoice[ch]->mPendingSeek = aSeconds;
+  } else {
+    syncVoicePosition_internal(ch);
+    singleres = mVoice[ch]->seek(aSeconds, mScratch.mData, mScratchSize);
+    if (singleres != SO_NO_ERROR) {
+      res = singleres;
+    }
   }
   FOR_ALL_VOICES_POST
   return res;
 }
 
+// Runs one voice's seek on the seek worker. While the instance carries the
+// SEEKING flag the mixer and API leave it alone, so the codec work can run
+// without the audio mutex.
+class SeekTask : public Thread::PoolTask {
+ public:
+  Soloud* mSoloud;
+  AudioSource* mSource;
+  AudioSourceInstance* mInstance;
+  unsigned int mVoice;
+  time mTarget;
+  // Tasks waiting to be queued, see seekAsync
+  SeekTask* mNext;
+
+  SeekTask(Soloud* aSoloud, unsigned int aVoice, time aTarget) {
+    mSoloud = aSoloud;
+    mSource = aSoloud->mVoiceSourceLink[aVoice].mSource;
+    mInstance = aSoloud->mVoice[aVoice];
+    mVoice = aVoice;
+    mTarget = aTarget;
+    mNext = NULL;
+  }
+
+  virtual void work() {
+    AlignedFloatBuffer scratch;
+    unsigned int scratchsize = mSoloud->mScratchSize;
+    scratch.init(scratchsize);
+    for (;;) {
+      mInstance->seek(mTarget, scratch.mData, scratchsize);
+
+      mSoloud->lockAudioMutex_internal();
+      if (mSoloud->mVoice[mVoice] != mInstance) {
+        // Stopped while we were seeking; the instance is ours to delete. The
+        // source waits for mPendingSeeks, so its data is still there.
+        delete mInstance;
+        break;
+      }
+      if (mInstance->mPendingSeek >= 0) {
+        mTarget = mInstance->mPendingSeek;
+        mInstance->mPendingSeek = -1;
+        mSoloud->unlockAudioMutex_internal();
+        continue;
+      }
+      mInstance->mFlags &= ~AudioSourceInstance::SEEKING;
+      if (mInstance->mPendingBaseSamplerate >= 0) {
+        mInstance->mBaseSamplerate = mInstance->mPendingBaseSamplerate;
+        mInstance->mPendingBaseSamplerate = -1;
+      }
+      if (mInstance->mPendingLoopPoint >= 0) {
+        mInstance->mLoopPoint = mInstance->mPendingLoopPoint;
+        mInstance->mPendingLoopPoint = -1;
+      }
+      mSoloud->updateVoiceRelativePlaySpeed_internal(mVoice);
+      mSoloud->updateVoiceState_internal(mVoice);
+      mSoloud->publishVoice_internal(mVoice);
+      mSoloud->mActiveVoiceDirty = true;
+      break;
+    }
+    if (mSource) {
+      mSource->mPendingSeeks--;
+    }
+    mSoloud->mPendingSeeks--;
+    mSoloud->unlockAudioMutex_internal();
+    delete this;
+  }
+};
+
+result Soloud::seekAsync(handle aVoiceHandle, time aSeconds) {
+  lockAudioMutex_internal();
+  if (!mSeekPool) {
+    mSeekPool = new Thread::Pool;
+    mSeekPool->init(1);
+  }
+  unlockAudioMutex_internal();
+
+  // Tasks are queued after the mutex is released: a full pool runs the task
+  // on the calling thread, and the task needs the mutex.
+  SeekTask* tasks = NULL;
+  FOR_ALL_VOICES_PRE
+  AudioSourceInstance* v = mVoice[ch];
+  if (v->mFlags & AudioSourceInstance::SEEKING) {
+    v->mPendingSeek = aSeconds;
+  } else if (v->mFlags & AudioSourceInstance::BUS) {
+    // A bus seek mixes its voices, which needs the audio mutex; do it here.
+    syncVoicePosition_internal(ch);
+    v->seek(aSeconds, mScratch.mData, mScratchSize);
+  } else {
+    syncVoicePosition_internal(ch);
+    v->mFlags |= AudioSourceInstance::SEEKING;
+    v->mPendingSeek = -1;
+    updateVoiceState_internal(ch);
+    mActiveVoiceDirty = true;
+    mPendingSeeks++;
+    SeekTask* task = new SeekTask(this, ch, aSeconds);
+    if (task->mSource) {
+      task->mSource->mPendingSeeks++;
+    }
+    task->mNext = tasks;
+    tasks = task;
+  }
+  FOR_ALL_VOICES_POST
+  while (tasks) {
+    SeekTask* next = tasks->mNext;
+    mSeekPool->addWork(tasks);
+    tasks = next;
+  }
+  return SO_NO_ERROR;
+}
+
 void Soloud::stop(handle aVoiceHandle) {
   FOR_ALL_VOICES_PRE
   stopVoice_internal(ch);
@@ -148,15 +285,19 @@ void Soloud::stop(handle aVoiceHandle) {
 void Soloud::stopAudioSource(AudioSource& aSound) {
   if (aSound.mAudioSourceID) {
     lockAudioMutex_internal();
-
-    int i;
-    for (i = 0; i < (signed)mHighestVoice; i++) {
-      if (mVoice[i] && mVoice[i]->mAudioSourceID == aSound.mAudioSourceID) {
-        stopVoice_internal(i);
-      }
+    stopSourceVoices_internal(aSound);
+    // Instances still being seeked read the source's data until their task
+    // sees the voice is gone and deletes them.
+    while (aSound.mPendingSeeks) {
+      unlockAudioMutex_internal();
+      Thread::sleep(1);
+      lockAudioMutex_internal();
     }
     unlockAudioMutex_internal();
   }
+  if (aSound.mVirtualVoices) {
+    stopVirtualVoices_internal(&aSound);
+  }
 }
 
 void Soloud::stopAll() {
@@ -166,19 +307,28 @@ void Soloud::stopAll() {
     stopVoice_internal(i);
   }
   unlockAudioMutex_internal();
+  stopVirtualVoices_internal(NULL);
 }
 
 int Soloud::countAudioSource(AudioSource& aSound) {
   int count = 0;
   if (aSound.mAudioSourceID) {
     lockAudioMutex_internal();
-
-    int i;
-    for (i = 0; i < (signed)mHighestVoice; i++) {
-      if (mVoice[i] && mVoice[i]->mAudioSourceID == aSound.mAudioSourceID) {
+    if (aSound.mVoiceListOwner == this) {
+      int i;
+      for (i = aSound.mFirstVoice; i != -1; i = mVoiceSourceLink[i].mNext) {
         count++;
       }
     }
+    if (mUnlistedVoices) {
+      unsigned int i;
+      for (i = 0; i < mHighestVoice; i++) {
+        const VoiceSourceLink& link = mVoiceSourceLink[i];
+        if (link.mSource == &aSound && !link.mListed) {
+          count++;
+        }
+      }
+    }
     unlockAudioMutex_internal();
   }
   return count;
@@ -33,7 +33,8 @@ void Soloud::schedulePause(handle aVoiceHandle, time aTime) {
     return;
   }
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mPauseScheduler.set(1, 0, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mPauseScheduler.set(1, 0, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -43,7 +44,8 @@ void Soloud::scheduleStop(handle aVoiceHandle, time aTime) {
     return;
   }
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mStopScheduler.set(1, 0, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mStopScheduler.set(1, 0, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -55,7 +57,8 @@ void Soloud::fadeVolume(handle aVoiceHandle, float aTo, time aTime) {
   }
 
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mVolumeFader.set(from, aTo, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mVolumeFader.set(from, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -67,7 +70,8 @@ void Soloud::fadePan(handle aVoiceHandle, float aTo, time aTime) {
   }
 
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mPanFader.set(from, aTo, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mPanFader.set(from, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -79,7 +83,8 @@ void Soloud::fadeRelativePlaySpeed(handle aVoiceHandle, float aTo, time aTime) {
   }
   FOR_ALL_VOICES_PRE
   mVoice[ch]->mRelativePlaySpeedFader.set(
-    from, aTo, aTime, mVoice[ch]->mStreamTime);
+    from, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -100,7 +105,8 @@ void Soloud::oscillateVolume(
   }
 
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mVolumeFader.setLFO(aFrom, aTo, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mVolumeFader.setLFO(aFrom, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -112,7 +118,8 @@ void Soloud::oscillatePan(
   }
 
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mPanFader.setLFO(aFrom, aTo, aTime, mVoice[ch]->mStreamTime);
+  mVoice[ch]->mPanFader.setLFO(aFrom, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
@@ -125,7 +132,8 @@ void Soloud::oscillateRelativePlaySpeed(
 
   FOR_ALL_VOICES_PRE
   mVoice[ch]->mRelativePlaySpeedFader.setLFO(
-    aFrom, aTo, aTime, mVoice[ch]->mStreamTime);
+    aFrom, aTo, aTime, mVoiceStreamTime[ch]);
+  mVoiceState[ch] |= VOICE_FADING;
   FOR_ALL_VOICES_POST
 }
 
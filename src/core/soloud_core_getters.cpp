@@ -27,6 +27,34 @@ freely, subject to the following restrictions:
 // Getters - return information about SoLoud state
 
 namespace SoLoud {
+// Read one field of a voice's published snapshot without taking the audio
+// mutex. Returns false if the handle doesn't name a live voice.
+template <class T>
+static bool readVoiceSnapshot(Soloud& aSoloud, handle aVoiceHandle,
+  std::atomic<T> VoiceSnapshot::*aField, T& aValue) {
+  int ch = aSoloud.getSnapshotSlot_internal(aVoiceHandle);
+  if (ch == -1) {
+    return false;
+  }
+  const VoiceSnapshot& snapshot = aSoloud.mVoiceSnapshot[ch];
+  for (;;) {
+    unsigned int seq = snapshot.mSequence.load(std::memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    handle h = snapshot.mHandle.load(std::memory_order_relaxed);
+    T v = (snapshot.*aField).load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (snapshot.mSequence.load(std::memory_order_relaxed) == seq) {
+      if (h != aVoiceHandle) {
+        return false;
+      }
+      aValue = v;
+      return true;
+    }
+  }
+}
+
 unsigned int Soloud::getVersion() const {
   return SOLOUD_VERSION;
 }
@@ -47,53 +75,89 @@ handle Soloud::getHandleFromVoice_internal(unsigned int aVoice) const {
   if (mVoice[aVoice] == 0) {
     return 0;
   }
-  return (aVoice + 1) | (mVoice[aVoice]->mPlayIndex << 12);
+  return (aVoice + 1) |
+         ((handle)mVoiceGeneration[aVoice] << SOLOUD_HANDLE_GENERATION_SHIFT);
 }
 
 int Soloud::getVoiceFromHandle_internal(handle aVoiceHandle) const {
-  // If this is a voice group handle, pick the first handle from the group
-  handle* h = voiceGroupHandleToArray_internal(aVoiceHandle);
-  if (h != NULL) {
-    aVoiceHandle = *h;
+  // If this is a voice group handle, pick the first voice from the group
+  if ((aVoiceHandle & 0xfffff000) == 0xfffff000) {
+    int c = getVoiceGroupIndex_internal(aVoiceHandle);
+    if (c == -1 || mVoiceGroup[c].mFirstMember == -1) {
+      return -1;
+    }
+    return mVoiceGroupMember[mVoiceGroup[c].mFirstMember].mVoice;
   }
 
   if (aVoiceHandle == 0) {
     return -1;
   }
 
-  int ch = (aVoiceHandle & 0xfff) - 1;
-  unsigned int idx = aVoiceHandle >> 12;
-  if (mVoice[ch] && (mVoice[ch]->mPlayIndex & 0xfffff) == idx) {
+  int ch = (int)(aVoiceHandle & SOLOUD_HANDLE_SLOT_MASK) - 1;
+  if (ch >= VOICE_COUNT) {
+    return -1;
+  }
+  unsigned int generation = aVoiceHandle >> SOLOUD_HANDLE_GENERATION_SHIFT;
+  if (mVoice[ch] && mVoiceGeneration[ch] == generation) {
     return ch;
   }
   return -1;
 }
 
+int Soloud::getSnapshotSlot_internal(handle& aVoiceHandle) {
+  if ((aVoiceHandle & 0xfffff000) == 0xfffff000) {
+    // Voice group contents are guarded by the audio mutex.
+    lockAudioMutex_internal();
+    int first = getVoiceFromHandle_internal(aVoiceHandle);
+    aVoiceHandle = first != -1 ? getHandleFromVoice_internal(first) : 0;
+    unlockAudioMutex_internal();
+  }
+  if (aVoiceHandle == 0) {
+    return -1;
+  }
+  int ch = (int)(aVoiceHandle & SOLOUD_HANDLE_SLOT_MASK) - 1;
+  if (ch >= VOICE_COUNT) {
+    return -1;
+  }
+  return ch;
+}
+
 unsigned int Soloud::getMaxActiveVoiceCount() const {
   return mMaxActiveVoices;
 }
 
+unsigned int Soloud::getGovernorLevel() const {
+  return mGovernorLevelSnapshot.load(std::memory_order_acquire);
+}
+
+float Soloud::getMixLoad() const {
+  return mMixLoadSnapshot.load(std::memory_order_acquire);
+}
+
+unsigned int Soloud::getDirectVoiceCount() const {
+  return mDirectVoiceCountSnapshot.load(std::memory_order_acquire);
+}
+
+bool Soloud::isIdle() const {
+  return mIdleSnapshot.load(std::memory_order_acquire);
+}
+
 unsigned int Soloud::getActiveVoiceCount() {
+  if (!mActiveVoiceDirty) {
+    return mActiveVoiceCountSnapshot.load(std::memory_order_acquire);
+  }
   lockAudioMutex_internal();
   if (mActiveVoiceDirty) {
     calcActiveVoices_internal();
   }
   unsigned int c = mActiveVoiceCount;
+  mActiveVoiceCountSnapshot.store(c, std::memory_order_release);
   unlockAudioMutex_internal();
   return c;
 }
 
 unsigned int Soloud::getVoiceCount() {
-  lockAudioMutex_internal();
-  int i;
-  int c = 0;
-  for (i = 0; i < (signed)mHighestVoice; i++) {
-    if (mVoice[i]) {
-      c++;
-    }
-  }
-  unlockAudioMutex_internal();
-  return c;
+  return mVoiceCountSnapshot.load(std::memory_order_acquire);
 }
 
 bool Soloud::isValidVoiceHandle(handle aVoiceHandle) {
@@ -102,49 +166,28 @@ bool Soloud::isValidVoiceHandle(handle aVoiceHandle) {
     return 0;
   }
 
-  lockAudioMutex_internal();
-  if (getVoiceFromHandle_internal(aVoiceHandle) != -1) {
-    unlockAudioMutex_internal();
-    return 1;
-  }
-  unlockAudioMutex_internal();
-  return 0;
+  handle h = 0;
+  return readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mHandle, h);
 }
 
 time Soloud::getLoopPoint(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  time v = mVoice[ch]->mLoopPoint;
-  unlockAudioMutex_internal();
+  time v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mLoopPoint, v);
   return v;
 }
 
 bool Soloud::getLooping(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  bool v = (mVoice[ch]->mFlags & AudioSourceInstance::LOOPING) != 0;
-  unlockAudioMutex_internal();
-  return v;
+  unsigned int flags = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mFlags, flags);
+  return (flags & AudioSourceInstance::LOOPING) != 0;
 }
 
 bool Soloud::getAutoStop(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
+  unsigned int flags = 0;
+  if (!readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mFlags, flags)) {
     return 0;
   }
-  bool v = (mVoice[ch]->mFlags & AudioSourceInstance::DISABLE_AUTOSTOP) != 0;
-  unlockAudioMutex_internal();
-  return !v;
+  return (flags & AudioSourceInstance::DISABLE_AUTOSTOP) == 0;
 }
 
 float Soloud::getInfo(handle aVoiceHandle, unsigned int mInfoKey) {
@@ -154,117 +197,74 @@ float Soloud::getInfo(handle aVoiceHandle, unsigned int mInfoKey) {
     unlockAudioMutex_internal();
     return 0;
   }
+  // A seeking voice's instance belongs to the seek worker.
+  if (mVoice[ch]->mFlags & AudioSourceInstance::SEEKING) {
+    unlockAudioMutex_internal();
+    return 0;
+  }
   float v = mVoice[ch]->getInfo(mInfoKey);
   unlockAudioMutex_internal();
   return v;
 }
 
 float Soloud::getVolume(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  float v = mVoice[ch]->mSetVolume;
-  unlockAudioMutex_internal();
+  float v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mVolume, v);
   return v;
 }
 
 float Soloud::getOverallVolume(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  float v = mVoice[ch]->mOverallVolume;
-  unlockAudioMutex_internal();
+  float v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mOverallVolume, v);
   return v;
 }
 
 float Soloud::getPan(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  float v = mVoice[ch]->mPan;
-  unlockAudioMutex_internal();
+  float v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mPan, v);
   return v;
 }
 
 time Soloud::getStreamTime(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  double v = mVoice[ch]->mStreamTime;
-  unlockAudioMutex_internal();
+  time v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mStreamTime, v);
   return v;
 }
 
 time Soloud::getStreamPosition(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  double v = mVoice[ch]->mStreamPosition;
-  unlockAudioMutex_internal();
+  time v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mStreamPosition, v);
   return v;
 }
 
 float Soloud::getRelativePlaySpeed(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 1;
-  }
-  float v = mVoice[ch]->mSetRelativePlaySpeed;
-  unlockAudioMutex_internal();
+  float v = 1;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mRelativePlaySpeed, v);
   return v;
 }
 
 float Soloud::getSamplerate(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  float v = mVoice[ch]->mBaseSamplerate;
-  unlockAudioMutex_internal();
+  float v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mSamplerate, v);
   return v;
 }
 
 bool Soloud::getPause(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  int v = !!(mVoice[ch]->mFlags & AudioSourceInstance::PAUSED);
-  unlockAudioMutex_internal();
-  return v != 0;
+  unsigned int flags = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mFlags, flags);
+  return (flags & AudioSourceInstance::PAUSED) != 0;
+}
+
+bool Soloud::isSeeking(handle aVoiceHandle) {
+  unsigned int flags = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mFlags, flags);
+  return (flags & AudioSourceInstance::SEEKING) != 0;
 }
 
 bool Soloud::getProtectVoice(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  int v = !!(mVoice[ch]->mFlags & AudioSourceInstance::PROTECTED);
-  unlockAudioMutex_internal();
-  return v != 0;
+  unsigned int flags = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mFlags, flags);
+  return (flags & AudioSourceInstance::PROTECTED) != 0;
 }
 
 int Soloud::findFreeVoice_internal() {
@@ -295,14 +295,8 @@ int Soloud::findFreeVoice_internal() {
 }
 
 unsigned int Soloud::getLoopCount(handle aVoiceHandle) {
-  lockAudioMutex_internal();
-  int ch = getVoiceFromHandle_internal(aVoiceHandle);
-  if (ch == -1) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  int v = mVoice[ch]->mLoopCount;
-  unlockAudioMutex_internal();
+  unsigned int v = 0;
+  readVoiceSnapshot(*this, aVoiceHandle, &VoiceSnapshot::mLoopCount, v);
   return v;
 }
 
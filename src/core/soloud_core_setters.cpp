@@ -53,9 +53,45 @@ result Soloud::setRelativePlaySpeed(handle aVoiceHandle, float aSpeed) {
 
 void Soloud::setSamplerate(handle aVoiceHandle, float aSamplerate) {
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mBaseSamplerate = aSamplerate;
-  updateVoiceRelativePlaySpeed_internal(ch);
+  if (mVoice[ch]->mFlags & AudioSourceInstance::SEEKING) {
+    // The seek worker reads it; applied when the seek lands
+    mVoice[ch]->mPendingBaseSamplerate = aSamplerate;
+  } else {
+    mVoice[ch]->mBaseSamplerate = aSamplerate;
+    updateVoiceRelativePlaySpeed_internal(ch);
+  }
+  FOR_ALL_VOICES_POST
+}
+
+result Soloud::setSend(handle aVoiceHandle, unsigned int aSendId,
+  handle aReturnBusHandle, float aVolume) {
+  if (aSendId >= SENDS_PER_VOICE) {
+    return INVALID_PARAMETER;
+  }
+  if (aReturnBusHandle) {
+    lockAudioMutex_internal();
+    int ret = getVoiceFromHandle_internal(aReturnBusHandle);
+    if (ret < 0 || !(mVoice[ret]->mFlags & AudioSourceInstance::BUS)) {
+      unlockAudioMutex_internal();
+      return INVALID_PARAMETER;
+    }
+    ((BusInstance*)mVoice[ret])->initSendBuffer();
+    unlockAudioMutex_internal();
+  }
+
+  FOR_ALL_VOICES_PRE
+  AudioSourceInstance* v = mVoice[ch];
+  v->mSendBus[aSendId] = aReturnBusHandle;
+  v->mSendVolume[aSendId] = aVolume;
+  v->mFlags &= ~AudioSourceInstance::HAS_SENDS;
+  unsigned int i;
+  for (i = 0; i < SENDS_PER_VOICE; i++) {
+    if (v->mSendBus[i]) {
+      v->mFlags |= AudioSourceInstance::HAS_SENDS;
+    }
+  }
   FOR_ALL_VOICES_POST
+  return SO_NO_ERROR;
 }
 
 void Soloud::setPause(handle aVoiceHandle, bool aPause) {
@@ -64,6 +100,41 @@ void Soloud::setPause(handle aVoiceHandle, bool aPause) {
   FOR_ALL_VOICES_POST
 }
 
+result Soloud::setGovernor(bool aEnable, float aHighLoad, float aLowLoad,
+  unsigned int aHoldBuffers, unsigned int aMaxLevel) {
+  if (aLowLoad < 0 || aHighLoad <= aLowLoad ||
+      aMaxLevel > GOVERNOR_LIMIT_VOICES) {
+    return INVALID_PARAMETER;
+  }
+  // The audio thread reads these without the mutex, and steps back to full
+  // quality once disabled.
+  mGovernorHighLoad = aHighLoad;
+  mGovernorLowLoad = aLowLoad;
+  mGovernorHoldBuffers = aHoldBuffers;
+  mGovernorMaxLevel = aMaxLevel;
+  mGovernorEnabled = aEnable;
+  return SO_NO_ERROR;
+}
+
+result Soloud::setGovernorVoiceLimit(unsigned int aVoiceCount) {
+  if (aVoiceCount >= VOICE_COUNT) {
+    return INVALID_PARAMETER;
+  }
+  lockAudioMutex_internal();
+  mGovernorVoiceLimit = aVoiceCount;
+  mActiveVoiceDirty = true;
+  unlockAudioMutex_internal();
+  return SO_NO_ERROR;
+}
+
+void Soloud::setGovernorCallback(
+  governorCallback aCallback, void* aUserData) {
+  lockAudioMutex_internal();
+  mGovernorCallback = aCallback;
+  mGovernorUserData = aUserData;
+  unlockAudioMutex_internal();
+}
+
 result Soloud::setMaxActiveVoiceCount(unsigned int aVoiceCount) {
   if (aVoiceCount == 0 || aVoiceCount >= VOICE_COUNT) {
     return INVALID_PARAMETER;
@@ -93,6 +164,7 @@ void Soloud::setPauseAll(bool aPause) {
   int ch;
   for (ch = 0; ch < (signed)mHighestVoice; ch++) {
     setVoicePause_internal(ch, aPause);
+    publishVoice_internal(ch);
   }
   unlockAudioMutex_internal();
 }
@@ -160,12 +232,17 @@ void Soloud::setInaudibleBehavior(
   if (aKill) {
     mVoice[ch]->mFlags |= AudioSourceInstance::INAUDIBLE_KILL;
   }
+  updateVoiceState_internal(ch);
   FOR_ALL_VOICES_POST
 }
 
 void Soloud::setLoopPoint(handle aVoiceHandle, time aLoopPoint) {
   FOR_ALL_VOICES_PRE
-  mVoice[ch]->mLoopPoint = aLoopPoint;
+  if (mVoice[ch]->mFlags & AudioSourceInstance::SEEKING) {
+    mVoice[ch]->mPendingLoopPoint = aLoopPoint;
+  } else {
+    mVoice[ch]->mLoopPoint = aLoopPoint;
+  }
   FOR_ALL_VOICES_POST
 }
 
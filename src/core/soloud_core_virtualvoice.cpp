@@ -0,0 +1,372 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2020 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#include <math.h>
+
+#include "soloud.h"
+
+// Virtual voice operations
+
+namespace SoLoud {
+// Below this volume a virtual voice is never given a real voice
+static const float kVirtualAudibleVolume = 0.001f;
+// Realized voices rank as this much louder, so two emitters at about the
+// same distance don't trade places every frame.
+static const float kVirtualHoldBonus = 1.25f;
+
+static bool ranksAbove(const VirtualVoice& aA, const VirtualVoice& aB) {
+  if (aA.mPriority != aB.mPriority) {
+    return aA.mPriority > aB.mPriority;
+  }
+  float a = aA.mAudibility * (aA.mVoice ? kVirtualHoldBonus : 1);
+  float b = aB.mAudibility * (aB.mVoice ? kVirtualHoldBonus : 1);
+  return a > b;
+}
+
+// Fold a position past the end of a looping source back into the loop
+static time wrapPlayhead(time aPosition, time aLength, time aLoopPoint) {
+  if (aLoopPoint <= 0 || aLoopPoint >= aLength) {
+    return fmod(aPosition, aLength);
+  }
+  return aLoopPoint + fmod(aPosition - aLoopPoint, aLength - aLoopPoint);
+}
+
+handle Soloud::playVirtual(AudioSource& aSound, float aPosX, float aPosY,
+  float aPosZ, float aVolume, unsigned int aPriority, unsigned int aBus) {
+  if (mVirtualVoiceFree == -1) {
+    // Array is full, allocate more memory
+    unsigned int oldcount = mVirtualVoiceCapacity;
+    unsigned int count = oldcount ? oldcount * 2 : 64;
+    if (count > SOLOUD_VIRTUAL_INDEX_MASK) {
+      count = SOLOUD_VIRTUAL_INDEX_MASK;
+    }
+    if (count == oldcount) {
+      return 0;
+    }
+    VirtualVoice* n = new VirtualVoice[count];
+    unsigned int* rank = new unsigned int[count];
+    if (n == NULL || rank == NULL) {
+      delete[] n;
+      delete[] rank;
+      return 0;
+    }
+    unsigned int j;
+    for (j = 0; j < oldcount; j++) {
+      n[j] = mVirtualVoice[j];
+    }
+    for (j = oldcount; j < count; j++) {
+      n[j].mSource = NULL;
+      n[j].mVoice = 0;
+      n[j].mGeneration = 0;
+      n[j].mNextFree = j + 1 < count ? (int)j + 1 : -1;
+    }
+    delete[] mVirtualVoice;
+    delete[] mVirtualVoiceRank;
+    mVirtualVoice = n;
+    mVirtualVoiceRank = rank;
+    mVirtualVoiceCapacity = count;
+    mVirtualVoiceFree = oldcount;
+  }
+
+  lockAudioMutex_internal();
+  time now = mStreamTime;
+  unlockAudioMutex_internal();
+
+  int i = mVirtualVoiceFree;
+  VirtualVoice& v = mVirtualVoice[i];
+  mVirtualVoiceFree = v.mNextFree;
+  v.mSource = &aSound;
+  v.mPosition[0] = aPosX;
+  v.mPosition[1] = aPosY;
+  v.mPosition[2] = aPosZ;
+  v.mVolume = aVolume;
+  v.mPriority = aPriority;
+  v.mBus = aBus;
+  v.mPlayhead = 0;
+  v.mPlayheadTime = now;
+  v.mVoice = 0;
+  v.mAudibility = 0;
+  v.mNextFree = -1;
+  v.mGeneration++;
+  aSound.mSoloud = this;
+  aSound.mVirtualVoices++;
+  mVirtualVoiceCount++;
+  return (handle)(i + 1) |
+         ((handle)v.mGeneration << SOLOUD_VIRTUAL_GENERATION_SHIFT);
+}
+
+int Soloud::getVirtualVoiceIndex_internal(handle aVirtualHandle) const {
+  int i = (int)(aVirtualHandle & SOLOUD_VIRTUAL_INDEX_MASK) - 1;
+  if (i < 0 || i >= (int)mVirtualVoiceCapacity) {
+    return -1;
+  }
+  const VirtualVoice& v = mVirtualVoice[i];
+  if (!v.mSource ||
+      v.mGeneration != (aVirtualHandle >> SOLOUD_VIRTUAL_GENERATION_SHIFT)) {
+    return -1;
+  }
+  return i;
+}
+
+void Soloud::releaseVirtualVoice_internal(int aIndex) {
+  VirtualVoice& v = mVirtualVoice[aIndex];
+  if (v.mVoice) {
+    stop(v.mVoice);
+  }
+  v.mSource->mVirtualVoices--;
+  v.mSource = NULL;
+  v.mVoice = 0;
+  v.mNextFree = mVirtualVoiceFree;
+  mVirtualVoiceFree = aIndex;
+  mVirtualVoiceCount--;
+}
+
+void Soloud::stopVirtualVoices_internal(AudioSource* aSound) {
+  unsigned int i;
+  for (i = 0; i < mVirtualVoiceCapacity && mVirtualVoiceCount; i++) {
+    AudioSource* source = mVirtualVoice[i].mSource;
+    if (source && (!aSound || source == aSound)) {
+      releaseVirtualVoice_internal(i);
+    }
+  }
+}
+
+void Soloud::stopVirtualVoice(handle aVirtualHandle) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i != -1) {
+    releaseVirtualVoice_internal(i);
+  }
+}
+
+bool Soloud::isValidVirtualVoice(handle aVirtualHandle) {
+  return getVirtualVoiceIndex_internal(aVirtualHandle) != -1;
+}
+
+void Soloud::setVirtualVoicePosition(
+  handle aVirtualHandle, float aPosX, float aPosY, float aPosZ) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i == -1) {
+    return;
+  }
+  VirtualVoice& v = mVirtualVoice[i];
+  v.mPosition[0] = aPosX;
+  v.mPosition[1] = aPosY;
+  v.mPosition[2] = aPosZ;
+  if (v.mVoice) {
+    set3dSourcePosition(v.mVoice, aPosX, aPosY, aPosZ);
+  }
+}
+
+void Soloud::setVirtualVoiceVolume(handle aVirtualHandle, float aVolume) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i == -1) {
+    return;
+  }
+  VirtualVoice& v = mVirtualVoice[i];
+  v.mVolume = aVolume;
+  if (v.mVoice) {
+    setVolume(v.mVoice, aVolume < 0 ? v.mSource->mVolume : aVolume);
+  }
+}
+
+void Soloud::setVirtualVoicePriority(
+  handle aVirtualHandle, unsigned int aPriority) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i != -1) {
+    mVirtualVoice[i].mPriority = aPriority;
+  }
+}
+
+handle Soloud::getVirtualVoiceRealHandle(handle aVirtualHandle) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i == -1 || !isValidVoiceHandle(mVirtualVoice[i].mVoice)) {
+    return 0;
+  }
+  return mVirtualVoice[i].mVoice;
+}
+
+time Soloud::getVirtualVoicePlayhead(handle aVirtualHandle) {
+  int i = getVirtualVoiceIndex_internal(aVirtualHandle);
+  if (i == -1) {
+    return 0;
+  }
+  VirtualVoice& v = mVirtualVoice[i];
+  if (v.mVoice && isValidVoiceHandle(v.mVoice)) {
+    return getStreamPosition(v.mVoice);
+  }
+  lockAudioMutex_internal();
+  time now = mStreamTime;
+  unlockAudioMutex_internal();
+  time pos = v.mPlayhead + (now - v.mPlayheadTime);
+  time length = v.mSource->getLength();
+  if (length > 0 && pos >= length) {
+    if (!(v.mSource->mFlags & AudioSource::SHOULD_LOOP)) {
+      return length;
+    }
+    pos = wrapPlayhead(pos, length, v.mSource->mLoopPoint);
+  }
+  return pos;
+}
+
+unsigned int Soloud::getVirtualVoiceCount() {
+  return mVirtualVoiceCount;
+}
+
+void Soloud::setVirtualVoiceLimit(unsigned int aVoiceLimit) {
+  mVirtualVoiceLimit = aVoiceLimit;
+}
+
+void Soloud::updateVirtualVoices() {
+  if (!mVirtualVoiceCount) {
+    return;
+  }
+  lockAudioMutex_internal();
+  time now = mStreamTime;
+  unlockAudioMutex_internal();
+
+  // Step 1 - advance playheads, drop finished voices and score the rest
+  unsigned int i, candidates = 0;
+  for (i = 0; i < mVirtualVoiceCapacity; i++) {
+    VirtualVoice& v = mVirtualVoice[i];
+    if (!v.mSource) {
+      continue;
+    }
+    AudioSource& source = *v.mSource;
+    time length = source.getLength();
+    bool looping = (source.mFlags & AudioSource::SHOULD_LOOP) != 0;
+
+    if (v.mVoice && !isValidVoiceHandle(v.mVoice)) {
+      // The real voice ended, or was stolen or killed; the playhead tells
+      // which. Without a length there's no telling, so it has ended.
+      v.mVoice = 0;
+      if (!looping &&
+          (length <= 0 || v.mPlayhead + (now - v.mPlayheadTime) >= length)) {
+        releaseVirtualVoice_internal(i);
+        continue;
+      }
+    }
+    if (!v.mVoice) {
+      time pos = v.mPlayhead + (now - v.mPlayheadTime);
+      if (length > 0 && pos >= length) {
+        if (!looping) {
+          releaseVirtualVoice_internal(i);
+          continue;
+        }
+        pos = wrapPlayhead(pos, length, source.mLoopPoint);
+      }
+      v.mPlayhead = pos;
+      v.mPlayheadTime = now;
+    }
+
+    float dx = v.mPosition[0];
+    float dy = v.mPosition[1];
+    float dz = v.mPosition[2];
+    if (!(source.mFlags & AudioSource::LISTENER_RELATIVE)) {
+      dx -= m3dPosition[0];
+      dy -= m3dPosition[1];
+      dz -= m3dPosition[2];
+    }
+    float dist = (float)sqrt(dx * dx + dy * dy + dz * dz);
+    float volume = v.mVolume < 0 ? source.mVolume : v.mVolume;
+    v.mAudibility = volume * attenuate3d_internal(source.mAttenuator,
+                               source.m3dAttenuationModel, dist,
+                               source.m3dMinDistance, source.m3dMaxDistance,
+                               source.m3dAttenuationRolloff);
+
+    if (v.mAudibility >= kVirtualAudibleVolume) {
+      mVirtualVoiceRank[candidates] = i;
+      candidates++;
+    } else if (v.mVoice) {
+      v.mPlayhead = getStreamPosition(v.mVoice);
+      v.mPlayheadTime = now;
+      stop(v.mVoice);
+      v.mVoice = 0;
+    }
+  }
+
+  // Step 2 - move the most audible voices to the front (quickselect)
+  unsigned int* rank = mVirtualVoiceRank;
+  unsigned int keep = candidates < mVirtualVoiceLimit ? candidates
+                                                       : mVirtualVoiceLimit;
+  if (keep > 0 && keep < candidates) {
+    int left = 0, right = candidates - 1, k = keep - 1;
+    while (left < right) {
+      const VirtualVoice& pivot = mVirtualVoice[rank[(left + right) / 2]];
+      int l = left, r = right;
+      while (l <= r) {
+        while (ranksAbove(mVirtualVoice[rank[l]], pivot)) {
+          l++;
+        }
+        while (ranksAbove(pivot, mVirtualVoice[rank[r]])) {
+          r--;
+        }
+        if (l <= r) {
+          unsigned int temp = rank[l];
+          rank[l] = rank[r];
+          rank[r] = temp;
+          l++;
+          r--;
+        }
+      }
+      if (k <= r) {
+        right = r;
+      } else if (k >= l) {
+        left = l;
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Step 3 - release the real voices that dropped out before realizing the
+  // ones that came in, so the limit holds throughout
+  for (i = keep; i < candidates; i++) {
+    VirtualVoice& v = mVirtualVoice[rank[i]];
+    if (v.mVoice) {
+      v.mPlayhead = getStreamPosition(v.mVoice);
+      v.mPlayheadTime = now;
+      stop(v.mVoice);
+      v.mVoice = 0;
+    }
+  }
+  for (i = 0; i < keep; i++) {
+    VirtualVoice& v = mVirtualVoice[rank[i]];
+    if (v.mVoice) {
+      continue;
+    }
+    handle h = play3d(*v.mSource, v.mPosition[0], v.mPosition[1],
+      v.mPosition[2], 0, 0, 0, v.mVolume, true, v.mBus);
+    if (!isValidVoiceHandle(h)) {
+      continue;
+    }
+    // Start from the playhead; the seek runs off the audio thread so long
+    // streams don't stall the mix.
+    if (v.mPlayhead > 0 && v.mSource->getLength() > 0) {
+      seekAsync(h, v.mPlayhead);
+    }
+    setPause(h, false);
+    v.mVoice = h;
+  }
+}
+};  // namespace SoLoud
@@ -35,14 +35,10 @@ handle Soloud::createVoiceGroup() {
   unsigned int i;
   // Check if there's any deleted voice groups and re-use if found
   for (i = 0; i < mVoiceGroupCount; i++) {
-    if (mVoiceGroup[i] == NULL) {
-      mVoiceGroup[i] = new unsigned int[17];
-      if (mVoiceGroup[i] == NULL) {
-        unlockAudioMutex_internal();
-        return 0;
-      }
-      mVoiceGroup[i][0] = 16;
-      mVoiceGroup[i][1] = 0;
+    if (!mVoiceGroup[i].mInUse) {
+      mVoiceGroup[i].mInUse = true;
+      mVoiceGroup[i].mFirstMember = -1;
+      mVoiceGroup[i].mLastMember = -1;
       unlockAudioMutex_internal();
       return 0xfffff000 | i;
     }
@@ -56,7 +52,7 @@ handle Soloud::createVoiceGroup() {
     mVoiceGroupCount = 4;
   }
   mVoiceGroupCount *= 2;
-  unsigned int** vg = new unsigned int*[mVoiceGroupCount];
+  VoiceGroup* vg = new VoiceGroup[mVoiceGroupCount];
   if (vg == NULL) {
     mVoiceGroupCount = oldcount;
     unlockAudioMutex_internal();
@@ -67,85 +63,108 @@ handle Soloud::createVoiceGroup() {
   }
 
   for (; i < mVoiceGroupCount; i++) {
-    vg[i] = NULL;
+    vg[i].mInUse = false;
+    vg[i].mFirstMember = -1;
+    vg[i].mLastMember = -1;
   }
 
   delete[] mVoiceGroup;
   mVoiceGroup = vg;
   i = oldcount;
-  mVoiceGroup[i] = new unsigned int[17];
-  if (mVoiceGroup[i] == NULL) {
-    unlockAudioMutex_internal();
-    return 0;
-  }
-  mVoiceGroup[i][0] = 16;
-  mVoiceGroup[i][1] = 0;
+  mVoiceGroup[i].mInUse = true;
   unlockAudioMutex_internal();
   return 0xfffff000 | i;
 }
 
 // Destroy a voice group.
 result Soloud::destroyVoiceGroup(handle aVoiceGroupHandle) {
-  if (!isVoiceGroup(aVoiceGroupHandle)) {
+  lockAudioMutex_internal();
+  int c = getVoiceGroupIndex_internal(aVoiceGroupHandle);
+  if (c == -1) {
+    unlockAudioMutex_internal();
     return INVALID_PARAMETER;
   }
-  int c = aVoiceGroupHandle & 0xfff;
 
-  lockAudioMutex_internal();
-  delete[] mVoiceGroup[c];
-  mVoiceGroup[c] = NULL;
+  while (mVoiceGroup[c].mFirstMember != -1) {
+    releaseVoiceGroupMember_internal(mVoiceGroup[c].mFirstMember);
+  }
+  mVoiceGroup[c].mInUse = false;
   unlockAudioMutex_internal();
   return SO_NO_ERROR;
 }
 
 // Add a voice handle to a voice group
 result Soloud::addVoiceToGroup(handle aVoiceGroupHandle, handle aVoiceHandle) {
-  if (!isVoiceGroup(aVoiceGroupHandle)) {
+  lockAudioMutex_internal();
+  int c = getVoiceGroupIndex_internal(aVoiceGroupHandle);
+  if (c == -1) {
+    unlockAudioMutex_internal();
     return INVALID_PARAMETER;
   }
 
   // Don't consider adding invalid voice handles as an error, since the voice
-  // may just have ended.
-  if (!isValidVoiceHandle(aVoiceHandle)) {
+  // may just have ended. Voice groups can't be nested.
+  int ch = -1;
+  if ((aVoiceHandle & 0xfffff000) != 0xfffff000) {
+    ch = getVoiceFromHandle_internal(aVoiceHandle);
+  }
+  if (ch == -1) {
+    unlockAudioMutex_internal();
     return SO_NO_ERROR;
   }
 
-  trimVoiceGroup_internal(aVoiceGroupHandle);
-
-  int c = aVoiceGroupHandle & 0xfff;
-  unsigned int i;
-
-  lockAudioMutex_internal();
-
-  for (i = 1; i < mVoiceGroup[c][0]; i++) {
-    if (mVoiceGroup[c][i] == aVoiceHandle) {
+  int i;
+  for (i = mVoiceGroupMembership[ch]; i != -1;
+    i = mVoiceGroupMember[i].mVoiceNext) {
+    if (mVoiceGroupMember[i].mGroup == (unsigned int)c) {
       unlockAudioMutex_internal();
       return SO_NO_ERROR;  // already there
     }
+  }
 
-    if (mVoiceGroup[c][i] == 0) {
-      mVoiceGroup[c][i] = aVoiceHandle;
-      mVoiceGroup[c][i + 1] = 0;
-
+  if (mVoiceGroupMemberFree == -1) {
+    // Pool is full, allocate more memory
+    unsigned int oldcount = mVoiceGroupMemberCount;
+    unsigned int count = oldcount ? oldcount * 2 : 64;
+    VoiceGroupMember* n = new VoiceGroupMember[count];
+    if (n == NULL) {
       unlockAudioMutex_internal();
-      return SO_NO_ERROR;
+      return OUT_OF_MEMORY;
+    }
+    unsigned int j;
+    for (j = 0; j < oldcount; j++) {
+      n[j] = mVoiceGroupMember[j];
+    }
+    for (j = oldcount; j < count; j++) {
+      n[j].mVoice = -1;
+      n[j].mGroup = 0;
+      n[j].mPrev = -1;
+      n[j].mNext = -1;
+      n[j].mVoiceNext = j + 1 < count ? (int)j + 1 : -1;
     }
+    delete[] mVoiceGroupMember;
+    mVoiceGroupMember = n;
+    mVoiceGroupMemberCount = count;
+    mVoiceGroupMemberFree = oldcount;
   }
 
-  // Full group, allocate more memory
-  unsigned int* n = new unsigned int[mVoiceGroup[c][0] * 2 + 1];
-  if (n == NULL) {
-    unlockAudioMutex_internal();
-    return OUT_OF_MEMORY;
-  }
-  for (i = 0; i < mVoiceGroup[c][0]; i++) {
-    n[i] = mVoiceGroup[c][i];
+  int m = mVoiceGroupMemberFree;
+  VoiceGroupMember& member = mVoiceGroupMember[m];
+  mVoiceGroupMemberFree = member.mVoiceNext;
+
+  member.mVoice = ch;
+  member.mGroup = c;
+  member.mPrev = mVoiceGroup[c].mLastMember;
+  member.mNext = -1;
+  if (member.mPrev != -1) {
+    mVoiceGroupMember[member.mPrev].mNext = m;
+  } else {
+    mVoiceGroup[c].mFirstMember = m;
   }
-  n[n[0]] = aVoiceHandle;
-  n[n[0] + 1] = 0;
-  n[0] *= 2;
-  delete[] mVoiceGroup[c];
-  mVoiceGroup[c] = n;
+  mVoiceGroup[c].mLastMember = m;
+  member.mVoiceNext = mVoiceGroupMembership[ch];
+  mVoiceGroupMembership[ch] = m;
+
   unlockAudioMutex_internal();
   return SO_NO_ERROR;
 }
@@ -155,13 +174,9 @@ bool Soloud::isVoiceGroup(handle aVoiceGroupHandle) {
   if ((aVoiceGroupHandle & 0xfffff000) != 0xfffff000) {
     return 0;
   }
-  unsigned int c = aVoiceGroupHandle & 0xfff;
-  if (c >= mVoiceGroupCount) {
-    return 0;
-  }
 
   lockAudioMutex_internal();
-  bool res = mVoiceGroup[c] != NULL;
+  bool res = getVoiceGroupIndex_internal(aVoiceGroupHandle) != -1;
   unlockAudioMutex_internal();
 
   return res;
@@ -169,86 +184,121 @@ bool Soloud::isVoiceGroup(handle aVoiceGroupHandle) {
 
 // Is this voice group empty?
 bool Soloud::isVoiceGroupEmpty(handle aVoiceGroupHandle) {
-  // If not a voice group, yeah, we're empty alright..
-  if (!isVoiceGroup(aVoiceGroupHandle)) {
-    return 1;
-  }
-  trimVoiceGroup_internal(aVoiceGroupHandle);
-  int c = aVoiceGroupHandle & 0xfff;
-
   lockAudioMutex_internal();
-  bool res = mVoiceGroup[c][1] == 0;
+  int c = getVoiceGroupIndex_internal(aVoiceGroupHandle);
+  // If not a voice group, yeah, we're empty alright..
+  bool res = c == -1 || mVoiceGroup[c].mFirstMember == -1;
   unlockAudioMutex_internal();
 
   return res;
 }
 
-// Remove all non-active voices from group
-void Soloud::trimVoiceGroup_internal(handle aVoiceGroupHandle) {
-  if (!isVoiceGroup(aVoiceGroupHandle)) {
-    return;
+int Soloud::getVoiceGroupIndex_internal(handle aVoiceGroupHandle) const {
+  if ((aVoiceGroupHandle & 0xfffff000) != 0xfffff000) {
+    return -1;
   }
-  int c = aVoiceGroupHandle & 0xfff;
+  unsigned int c = aVoiceGroupHandle & 0xfff;
+  if (c >= mVoiceGroupCount || !mVoiceGroup[c].mInUse) {
+    return -1;
+  }
+  return c;
+}
 
-  lockAudioMutex_internal();
-  // empty group
-  if (mVoiceGroup[c][1] == 0) {
-    unlockAudioMutex_internal();
-    return;
+void Soloud::releaseVoiceGroupMember_internal(int aMember) {
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  VoiceGroupMember& member = mVoiceGroupMember[aMember];
+
+  // Unlink from the voice's membership chain
+  int* link = &mVoiceGroupMembership[member.mVoice];
+  while (*link != aMember) {
+    link = &mVoiceGroupMember[*link].mVoiceNext;
+  }
+  *link = member.mVoiceNext;
+
+  // Unlink from the group. mNext is left alone on purpose, see
+  // VoiceGroupMember.
+  if (member.mPrev != -1) {
+    mVoiceGroupMember[member.mPrev].mNext = member.mNext;
+  } else {
+    mVoiceGroup[member.mGroup].mFirstMember = member.mNext;
+  }
+  if (member.mNext != -1) {
+    mVoiceGroupMember[member.mNext].mPrev = member.mPrev;
+  } else {
+    mVoiceGroup[member.mGroup].mLastMember = member.mPrev;
   }
 
-  unsigned int i;
-  // first item in voice group is number of allocated indices
-  for (i = 1; i < mVoiceGroup[c][0]; i++) {
-    // If we hit a voice in the group that's not set, we're done
-    if (mVoiceGroup[c][i] == 0) {
-      unlockAudioMutex_internal();
-      return;
-    }
+  member.mVoice = -1;
+  member.mVoiceNext = mVoiceGroupMemberFree;
+  mVoiceGroupMemberFree = aMember;
+}
 
-    unlockAudioMutex_internal();
-    while (!isValidVoiceHandle(
-      mVoiceGroup[c][i]))  // function locks mutex, so we need to unlock it
-                           // before the call
-    {
-      lockAudioMutex_internal();
-      // current index is an invalid handle, move all following handles
-      // backwards
-      unsigned int j;
-      for (j = i; j < mVoiceGroup[c][0] - 1; j++) {
-        mVoiceGroup[c][j] = mVoiceGroup[c][j + 1];
-        // not a full group, we can stop copying
-        if (mVoiceGroup[c][j] == 0) {
-          break;
-        }
-      }
-      // be sure to mark the last one as unused in any case
-      mVoiceGroup[c][mVoiceGroup[c][0] - 1] = 0;
-      // did we end up with an empty group? we're done then
-      if (mVoiceGroup[c][i] == 0) {
-        unlockAudioMutex_internal();
-        return;
-      }
-      unlockAudioMutex_internal();
+void Soloud::leaveVoiceGroups_internal(unsigned int aVoice) {
+  SOLOUD_ASSERT(aVoice < VOICE_COUNT);
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  while (mVoiceGroupMembership[aVoice] != -1) {
+    releaseVoiceGroupMember_internal(mVoiceGroupMembership[aVoice]);
+  }
+}
+
+int Soloud::firstVoice_internal(handle aVoiceHandle, int& aMember) const {
+  int c = getVoiceGroupIndex_internal(aVoiceHandle);
+  if (c == -1) {
+    aMember = -1;
+    return getVoiceFromHandle_internal(aVoiceHandle);
+  }
+  aMember = mVoiceGroup[c].mFirstMember;
+  if (aMember == -1) {
+    return -1;
+  }
+  return mVoiceGroupMember[aMember].mVoice;
+}
+
+int Soloud::nextVoice_internal(int& aMember) const {
+  // Members released while we were standing on them still point onwards;
+  // skip over them.
+  while (aMember != -1) {
+    aMember = mVoiceGroupMember[aMember].mNext;
+    if (aMember != -1 && mVoiceGroupMember[aMember].mVoice != -1) {
+      return mVoiceGroupMember[aMember].mVoice;
     }
-    lockAudioMutex_internal();
   }
-  unlockAudioMutex_internal();
+  return -1;
 }
 
-handle* Soloud::voiceGroupHandleToArray_internal(
-  handle aVoiceGroupHandle) const {
-  if ((aVoiceGroupHandle & 0xfffff000) != 0xfffff000) {
-    return NULL;
+int Soloud::first3dVoice_internal(handle aVoiceHandle, int& aMember) const {
+  if ((aVoiceHandle & 0xfffff000) != 0xfffff000) {
+    aMember = -1;
+    int ch = (int)(aVoiceHandle & SOLOUD_HANDLE_SLOT_MASK) - 1;
+    if (ch != -1 && ch < VOICE_COUNT && m3dData[ch].mHandle == aVoiceHandle) {
+      return ch;
+    }
+    return -1;
   }
-  unsigned int c = aVoiceGroupHandle & 0xfff;
-  if (c >= mVoiceGroupCount) {
-    return NULL;
+  int c = getVoiceGroupIndex_internal(aVoiceHandle);
+  if (c == -1) {
+    aMember = -1;
+    return -1;
+  }
+  aMember = mVoiceGroup[c].mFirstMember;
+  if (aMember == -1) {
+    return -1;
+  }
+  int ch = mVoiceGroupMember[aMember].mVoice;
+  if (m3dData[ch].mHandle == getHandleFromVoice_internal(ch)) {
+    return ch;
   }
-  if (mVoiceGroup[c] == NULL) {
-    return NULL;
+  return next3dVoice_internal(aMember);
+}
+
+int Soloud::next3dVoice_internal(int& aMember) const {
+  int ch;
+  while ((ch = nextVoice_internal(aMember)) != -1) {
+    if (m3dData[ch].mHandle == getHandleFromVoice_internal(ch)) {
+      return ch;
+    }
   }
-  return mVoiceGroup[c] + 1;
+  return -1;
 }
 
 }  // namespace SoLoud
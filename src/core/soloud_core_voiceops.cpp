@@ -55,6 +55,7 @@ void Soloud::setVoicePause_internal(unsigned int aVoice, int aPause) {
     } else {
       mVoice[aVoice]->mFlags &= ~AudioSourceInstance::PAUSED;
     }
+    updateVoiceState_internal(aVoice);
   }
 }
 
@@ -106,6 +107,29 @@ void Soloud::stopVoice_internal(unsigned int aVoice) {
     // Delete via temporary variable to avoid recursion
     AudioSourceInstance* v = mVoice[aVoice];
     mVoice[aVoice] = 0;
+    mVoiceState[aVoice] = 0;
+    publishVoice_internal(aVoice);
+
+    VoiceSourceLink& link = mVoiceSourceLink[aVoice];
+    if (link.mSource && link.mListed) {
+      if (link.mPrev != -1) {
+        mVoiceSourceLink[link.mPrev].mNext = link.mNext;
+      } else {
+        link.mSource->mFirstVoice = link.mNext;
+        if (link.mNext == -1) {
+          // Let whichever engine plays the source next have the list
+          link.mSource->mVoiceListOwner = NULL;
+        }
+      }
+      if (link.mNext != -1) {
+        mVoiceSourceLink[link.mNext].mPrev = link.mPrev;
+      }
+    } else if (link.mSource) {
+      mUnlistedVoices--;
+    }
+    link.mSource = NULL;
+    link.mListed = false;
+    leaveVoiceGroups_internal(aVoice);
 
     unsigned int i;
     for (i = 0; i < mMaxActiveVoices; i++) {
@@ -114,15 +138,65 @@ void Soloud::stopVoice_internal(unsigned int aVoice) {
       }
     }
 
-    delete v;
+    // An asynchronous seek still owns the instance; it deletes it when it
+    // sees the voice is gone.
+    if (!(v->mFlags & AudioSourceInstance::SEEKING)) {
+      delete v;
+    }
+  }
+}
+
+void Soloud::stopSourceVoices_internal(AudioSource& aSound) {
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  // Stopping unlinks the voice, so keep taking the head. The list is given
+  // up with its last voice, after which the head may be another engine's.
+  while (aSound.mVoiceListOwner == this && aSound.mFirstVoice != -1 &&
+         mVoiceSourceLink[aSound.mFirstVoice].mSource == &aSound) {
+    stopVoice_internal(aSound.mFirstVoice);
+  }
+  if (mUnlistedVoices) {
+    unsigned int i;
+    for (i = 0; i < mHighestVoice; i++) {
+      if (mVoiceSourceLink[i].mSource == &aSound &&
+          !mVoiceSourceLink[i].mListed) {
+        stopVoice_internal(i);
+      }
+    }
   }
 }
 
+int Soloud::findSourceVoice_internal(
+  AudioSource& aSound, AudioSourceInstance* aInstance) {
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  if (aSound.mVoiceListOwner == this) {
+    int i;
+    for (i = aSound.mFirstVoice; i != -1; i = mVoiceSourceLink[i].mNext) {
+      if (mVoice[i] == aInstance) {
+        return i;
+      }
+    }
+  }
+  if (mUnlistedVoices) {
+    unsigned int i;
+    for (i = 0; i < mHighestVoice; i++) {
+      if (mVoiceSourceLink[i].mSource == &aSound && mVoice[i] == aInstance) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
 void Soloud::updateVoiceRelativePlaySpeed_internal(unsigned int aVoice) {
   SOLOUD_ASSERT(aVoice < VOICE_COUNT);
   SOLOUD_ASSERT(mInsideAudioThreadMutex);
   mVoice[aVoice]->mOverallRelativePlaySpeed =
     m3dData[aVoice].mDopplerValue * mVoice[aVoice]->mSetRelativePlaySpeed;
+  mVoiceSpeed[aVoice] = mVoice[aVoice]->mOverallRelativePlaySpeed;
+  // The seek worker reads mSamplerate; it is set again when the seek lands.
+  if (mVoice[aVoice]->mFlags & AudioSourceInstance::SEEKING) {
+    return;
+  }
   mVoice[aVoice]->mSamplerate =
     mVoice[aVoice]->mBaseSamplerate * mVoice[aVoice]->mOverallRelativePlaySpeed;
 }
@@ -132,6 +206,7 @@ void Soloud::updateVoiceVolume_internal(unsigned int aVoice) {
   SOLOUD_ASSERT(mInsideAudioThreadMutex);
   mVoice[aVoice]->mOverallVolume =
     mVoice[aVoice]->mSetVolume * m3dData[aVoice].m3dVolume;
+  mVoiceVolume[aVoice] = mVoice[aVoice]->mOverallVolume;
   if (mVoice[aVoice]->mFlags & AudioSourceInstance::PAUSED) {
     int i;
     for (i = 0; i < MAX_CHANNELS; i++) {
@@ -140,4 +215,92 @@ void Soloud::updateVoiceVolume_internal(unsigned int aVoice) {
     }
   }
 }
+
+void Soloud::updateVoiceState_internal(unsigned int aVoice) {
+  SOLOUD_ASSERT(aVoice < VOICE_COUNT);
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  AudioSourceInstance* v = mVoice[aVoice];
+  if (!v) {
+    mVoiceState[aVoice] = 0;
+    return;
+  }
+  unsigned char state = VOICE_ALIVE;
+  if (v->mFlags & AudioSourceInstance::PAUSED) {
+    state |= VOICE_PAUSED;
+  }
+  if (v->mFlags & AudioSourceInstance::INAUDIBLE) {
+    state |= VOICE_INAUDIBLE;
+  }
+  if (v->mFlags & AudioSourceInstance::INAUDIBLE_TICK) {
+    state |= VOICE_TICK;
+  }
+  if (v->mFlags & AudioSourceInstance::SEEKING) {
+    state |= VOICE_SEEKING;
+  }
+  if (v->mRelativePlaySpeedFader.mActive > 0 || v->mVolumeFader.mActive > 0 ||
+      v->mPanFader.mActive > 0 || v->mPauseScheduler.mActive ||
+      v->mStopScheduler.mActive) {
+    state |= VOICE_FADING;
+  }
+  mVoiceState[aVoice] = state;
+}
+
+void Soloud::syncVoicePosition_internal(unsigned int aVoice) {
+  SOLOUD_ASSERT(aVoice < VOICE_COUNT);
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  if (mVoice[aVoice] && mVoicePositionDelta[aVoice] != 0) {
+    mVoice[aVoice]->mStreamPosition += mVoicePositionDelta[aVoice];
+    mVoicePositionDelta[aVoice] = 0;
+  }
+}
+
+void Soloud::publishVoice_internal(unsigned int aVoice) {
+  SOLOUD_ASSERT(aVoice < VOICE_COUNT);
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  // Writers are serialized by the audio mutex; readers retry while the
+  // sequence is odd or has moved.
+  VoiceSnapshot& s = mVoiceSnapshot[aVoice];
+  AudioSourceInstance* v = mVoice[aVoice];
+  handle h = getHandleFromVoice_internal(aVoice);
+  if ((s.mHandle.load(std::memory_order_relaxed) != 0) != (h != 0)) {
+    if (h) {
+      mVoiceCountSnapshot.fetch_add(1, std::memory_order_release);
+    } else {
+      mVoiceCountSnapshot.fetch_sub(1, std::memory_order_release);
+    }
+  }
+  unsigned int seq = s.mSequence.load(std::memory_order_relaxed);
+  s.mSequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.mHandle.store(h, std::memory_order_relaxed);
+  if (v) {
+    s.mFlags.store(v->mFlags, std::memory_order_relaxed);
+    s.mVolume.store(v->mSetVolume, std::memory_order_relaxed);
+    s.mOverallVolume.store(v->mOverallVolume, std::memory_order_relaxed);
+    s.mPan.store(v->mPan, std::memory_order_relaxed);
+    s.mRelativePlaySpeed.store(
+      v->mSetRelativePlaySpeed, std::memory_order_relaxed);
+    s.mSamplerate.store(v->mBaseSamplerate, std::memory_order_relaxed);
+    s.mStreamTime.store(mVoiceStreamTime[aVoice], std::memory_order_relaxed);
+    // The seek worker is writing these; keep the last published values.
+    if (!(v->mFlags & AudioSourceInstance::SEEKING)) {
+      s.mLoopCount.store(v->mLoopCount, std::memory_order_relaxed);
+      s.mStreamPosition.store(v->mStreamPosition + mVoicePositionDelta[aVoice],
+        std::memory_order_relaxed);
+    }
+    s.mLoopPoint.store(v->mLoopPoint, std::memory_order_relaxed);
+  }
+  s.mSequence.store(seq + 2, std::memory_order_release);
+}
+
+void Soloud::publishVoices_internal() {
+  SOLOUD_ASSERT(mInsideAudioThreadMutex);
+  unsigned int i;
+  for (i = 0; i < mHighestVoice; i++) {
+    if (mVoice[i]) {
+      publishVoice_internal(i);
+    }
+  }
+  mActiveVoiceCountSnapshot.store(mActiveVoiceCount, std::memory_order_release);
+}
 }  // namespace SoLoud
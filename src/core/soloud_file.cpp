@@ -30,7 +30,17 @@ distribution.
 #include <stdio.h>
 #include <string.h>
 
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "soloud.h"
+#include "soloud_rtcheck.h"
 
 namespace SoLoud {
 unsigned int File::read8() {
@@ -55,6 +65,7 @@ DiskFile::DiskFile(FILE* fp) : mFileHandle(fp) {
 }
 
 unsigned int DiskFile::read(unsigned char* aDst, unsigned int aBytes) {
+  SOLOUD_RT_CHECK_CALL(FILE_IO);
   return (unsigned int)fread(aDst, 1, aBytes, mFileHandle);
 }
 
@@ -62,6 +73,7 @@ unsigned int DiskFile::length() {
   if (!mFileHandle) {
     return 0;
   }
+  SOLOUD_RT_CHECK_CALL(FILE_IO);
   unsigned int pos = (unsigned int)ftell(mFileHandle);
   fseek(mFileHandle, 0, SEEK_END);
   unsigned int len = (unsigned int)ftell(mFileHandle);
@@ -70,6 +82,7 @@ unsigned int DiskFile::length() {
 }
 
 void DiskFile::seek(int aOffset) {
+  SOLOUD_RT_CHECK_CALL(FILE_IO);
   fseek(mFileHandle, aOffset, SEEK_SET);
 }
 
@@ -95,6 +108,7 @@ result DiskFile::open(const char* aFilename) {
   if (!aFilename) {
     return INVALID_PARAMETER;
   }
+  SOLOUD_RT_CHECK_CALL(FILE_IO);
   mFileHandle = fopen(aFilename, "rb");
   if (!mFileHandle) {
     return FILE_NOT_FOUND;
@@ -234,6 +248,124 @@ int MemoryFile::eof() {
   }
   return 0;
 }
+
+unsigned int MmapFile::read(unsigned char* aDst, unsigned int aBytes) {
+  if (mOffset >= mDataLength) {
+    return 0;
+  }
+  if (aBytes > mDataLength - mOffset) {
+    aBytes = mDataLength - mOffset;
+  }
+  memcpy(aDst, mDataPtr + mOffset, aBytes);
+  mOffset += aBytes;
+  return aBytes;
+}
+
+unsigned int MmapFile::length() {
+  return mDataLength;
+}
+
+void MmapFile::seek(int aOffset) {
+  if (aOffset >= 0) {
+    mOffset = aOffset;
+  } else {
+    mOffset = mDataLength + aOffset;
+  }
+  if (mOffset > mDataLength) {
+    mOffset = mDataLength;
+  }
+}
+
+unsigned int MmapFile::pos() {
+  return mOffset;
+}
+
+const unsigned char* MmapFile::getMemPtr() {
+  return mDataPtr;
+}
+
+int MmapFile::eof() {
+  if (mOffset >= mDataLength) {
+    return 1;
+  }
+  return 0;
+}
+
+MmapFile::~MmapFile() {
+  close();
+}
+
+MmapFile::MmapFile() {
+  mDataPtr = 0;
+  mDataLength = 0;
+  mOffset = 0;
+}
+
+void MmapFile::close() {
+  if (mDataPtr) {
+#if defined(_WIN32) || defined(_WIN64)
+    UnmapViewOfFile(mDataPtr);
+#else
+    munmap((void*)mDataPtr, mDataLength);
+#endif
+  }
+  mDataPtr = 0;
+  mDataLength = 0;
+  mOffset = 0;
+}
+
+result MmapFile::open(const char* aFilename) {
+  if (!aFilename) {
+    return INVALID_PARAMETER;
+  }
+  close();
+  SOLOUD_RT_CHECK_CALL(FILE_IO);
+#if defined(_WIN32) || defined(_WIN64)
+  HANDLE file = CreateFileA(aFilename, GENERIC_READ, FILE_SHARE_READ, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return FILE_NOT_FOUND;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+      size.QuadPart > 0xffffffffLL) {
+    CloseHandle(file);
+    return FILE_LOAD_FAILED;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping) {
+    return FILE_LOAD_FAILED;
+  }
+  // The view keeps the mapping object alive
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data) {
+    return FILE_LOAD_FAILED;
+  }
+  mDataLength = (unsigned int)size.QuadPart;
+#else
+  int fd = ::open(aFilename, O_RDONLY);
+  if (fd < 0) {
+    return FILE_NOT_FOUND;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0 ||
+      (unsigned long long)st.st_size > 0xffffffffULL) {
+    ::close(fd);
+    return FILE_LOAD_FAILED;
+  }
+  void* data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping outlives the descriptor
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return FILE_LOAD_FAILED;
+  }
+  mDataLength = (unsigned int)st.st_size;
+#endif
+  mDataPtr = (const unsigned char*)data;
+  return SO_NO_ERROR;
+}
 }  // namespace SoLoud
 
 extern "C" {
@@ -137,6 +137,10 @@ float FilterInstance::getFilterParameter(unsigned int aAttributeId) {
   return mParam[aAttributeId];
 }
 
+bool FilterInstance::hasTail() {
+  return true;
+}
+
 void FilterInstance::filter(float* aBuffer, unsigned int aSamples,
   unsigned int aBufferSize, unsigned int aChannels, float aSamplerate,
   double aTime) {
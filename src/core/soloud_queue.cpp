@@ -83,12 +83,15 @@ QueueInstance* Queue::createInstance() {
 
 void Queue::findQueueHandle() {
   // Find the channel the queue is playing on to calculate handle..
-  int i;
-  for (i = 0; mQueueHandle == 0 && i < (signed)mSoloud->mHighestVoice; i++) {
-    if (mSoloud->mVoice[i] == mInstance) {
-      mQueueHandle = mSoloud->getHandleFromVoice_internal(i);
-    }
+  if (mQueueHandle != 0) {
+    return;
   }
+  mSoloud->lockAudioMutex_internal();
+  int ch = mSoloud->findSourceVoice_internal(*this, mInstance);
+  if (ch != -1) {
+    mQueueHandle = mSoloud->getHandleFromVoice_internal(ch);
+  }
+  mSoloud->unlockAudioMutex_internal();
 }
 
 result Queue::play(AudioSource& aSound) {
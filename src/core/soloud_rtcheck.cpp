@@ -0,0 +1,227 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2020 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#include "soloud_rtcheck.h"
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define SOLOUD_RT_BACKTRACE
+#include <execinfo.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#include <cxxabi.h>
+#endif
+
+namespace SoLoud {
+namespace RtCheck {
+// Plain thread_locals without constructors, so reading them from inside
+// malloc never allocates.
+static thread_local int gMixerDepth = 0;
+static thread_local bool gReporting = false;
+static thread_local Scope* gScope = 0;
+
+static violationCallback gCallback = 0;
+static void* gUserData = 0;
+static std::atomic<unsigned int> gViolationCount(0);
+
+#define MAX_FRAMES 32
+
+Scope::Scope(const char* aName) {
+  mName = aName;
+  mParent = gScope;
+  gScope = this;
+}
+
+Scope::~Scope() {
+  gScope = mParent;
+}
+
+void setViolationCallback(violationCallback aCallback, void* aUserData) {
+  gCallback = aCallback;
+  gUserData = aUserData;
+}
+
+void enterMixer() {
+  gMixerDepth++;
+}
+
+void leaveMixer() {
+  gMixerDepth--;
+}
+
+bool isInMixer() {
+  return gMixerDepth > 0;
+}
+
+unsigned int getViolationCount() {
+  return gViolationCount.load(std::memory_order_relaxed);
+}
+
+const char* getViolationName(VIOLATION aViolation) {
+  switch (aViolation) {
+    case ALLOCATION:
+      return "heap allocation";
+    case DEALLOCATION:
+      return "heap free";
+    case MUTEX_WAIT:
+      return "mutex wait";
+    case SLEEP:
+      return "sleep";
+    case FILE_IO:
+      return "file I/O";
+  }
+  return "unknown";
+}
+
+// Appends the scope chain outermost first, e.g. "SoLoud::BusInstance >
+// SoLoud::WavStreamInstance".
+static void appendScope(char* aDst, size_t aSize, Scope* aScope) {
+  if (!aScope) {
+    return;
+  }
+  appendScope(aDst, aSize, aScope->mParent);
+  size_t len = strlen(aDst);
+  const char* name = aScope->mName;
+#if defined(__GNUC__) || defined(__clang__)
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(name, 0, 0, &status);
+  if (status == 0 && demangled) {
+    name = demangled;
+  }
+#endif
+  snprintf(aDst + len, aSize - len, "%s%s", len ? " > " : "", name);
+#if defined(__GNUC__) || defined(__clang__)
+  free(demangled);
+#endif
+}
+
+static void defaultReport(VIOLATION aViolation, const char* aContext,
+  void* const* aFrames, int aFrameCount, void* /*aUserData*/) {
+  fprintf(stderr, "SoLoud: %s in the mixer thread (%s)\n",
+    getViolationName(aViolation), aContext[0] ? aContext : "core");
+#ifdef SOLOUD_RT_BACKTRACE
+  if (aFrameCount > 0) {
+    backtrace_symbols_fd(aFrames, aFrameCount, 2);
+  }
+#endif
+}
+
+void check(VIOLATION aViolation) {
+  if (gMixerDepth <= 0 || gReporting) {
+    return;
+  }
+  // Everything below may allocate; don't report ourselves.
+  gReporting = true;
+  gViolationCount.fetch_add(1, std::memory_order_relaxed);
+  void* frames[MAX_FRAMES];
+  int framecount = 0;
+#ifdef SOLOUD_RT_BACKTRACE
+  framecount = backtrace(frames, MAX_FRAMES);
+#endif
+  char context[512];
+  context[0] = 0;
+  appendScope(context, sizeof(context), gScope);
+  if (gCallback) {
+    gCallback(aViolation, context, frames, framecount, gUserData);
+  } else {
+    defaultReport(aViolation, context, frames, framecount, 0);
+  }
+  gReporting = false;
+}
+}  // namespace RtCheck
+}  // namespace SoLoud
+
+#ifdef SOLOUD_RT_CHECK
+#ifdef __GLIBC__
+// glibc lets the program interpose the malloc family and still reach the real
+// allocator; operator new goes through malloc, so this covers both.
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t aSize) {
+  SOLOUD_RT_CHECK_CALL(ALLOCATION);
+  return __libc_malloc(aSize);
+}
+
+void* calloc(size_t aCount, size_t aSize) {
+  SOLOUD_RT_CHECK_CALL(ALLOCATION);
+  return __libc_calloc(aCount, aSize);
+}
+
+void* realloc(void* aPtr, size_t aSize) {
+  SOLOUD_RT_CHECK_CALL(ALLOCATION);
+  return __libc_realloc(aPtr, aSize);
+}
+
+void free(void* aPtr) {
+  if (aPtr) {
+    SOLOUD_RT_CHECK_CALL(DEALLOCATION);
+  }
+  __libc_free(aPtr);
+}
+}
+#else
+// Elsewhere only C++ allocations are seen.
+void* operator new(size_t aSize) {
+  SOLOUD_RT_CHECK_CALL(ALLOCATION);
+  void* p = malloc(aSize ? aSize : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t aSize) {
+  return operator new(aSize);
+}
+
+void operator delete(void* aPtr) noexcept {
+  if (aPtr) {
+    SOLOUD_RT_CHECK_CALL(DEALLOCATION);
+  }
+  free(aPtr);
+}
+
+void operator delete[](void* aPtr) noexcept {
+  operator delete(aPtr);
+}
+
+void operator delete(void* aPtr, size_t) noexcept {
+  operator delete(aPtr);
+}
+
+void operator delete[](void* aPtr, size_t) noexcept {
+  operator delete(aPtr);
+}
+#endif
+#endif
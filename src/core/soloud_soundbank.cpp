@@ -0,0 +1,404 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+#undef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "soloud_soundbank.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "soloud.h"
+#include "soloud_file.h"
+
+namespace SoLoud {
+SoundBank::SoundBank() {
+  mFile = 0;
+  mData = 0;
+  mLength = 0;
+  mHeader = 0;
+  mBuckets = 0;
+  mEntries = 0;
+  mNames = 0;
+}
+
+SoundBank::~SoundBank() {
+  close();
+}
+
+void SoundBank::close() {
+  delete mFile;
+  mFile = 0;
+  mData = 0;
+  mLength = 0;
+  mHeader = 0;
+  mBuckets = 0;
+  mEntries = 0;
+  mNames = 0;
+}
+
+result SoundBank::load(const char* aFilename) {
+  close();
+  MmapFile* mf = new MmapFile;
+  result res = mf->open(aFilename);
+  if (res != SO_NO_ERROR) {
+    delete mf;
+    return res;
+  }
+  mFile = mf;
+  return parse_internal();
+}
+
+result SoundBank::loadMem(const unsigned char* aData, unsigned int aLength,
+  bool aCopy, bool aTakeOwnership) {
+  if (!aData || aLength == 0) {
+    return INVALID_PARAMETER;
+  }
+  close();
+  const unsigned char* owned = 0;
+  // The index is read in place, so it has to be word aligned
+  if (!aCopy && ((size_t)aData & 3)) {
+    aCopy = true;
+    if (aTakeOwnership) {
+      owned = aData;
+    }
+  }
+  MemoryFile* mf = new MemoryFile;
+  result res = mf->openMem(aData, aLength, aCopy, aTakeOwnership);
+  delete[] owned;
+  if (res != SO_NO_ERROR) {
+    delete mf;
+    return res;
+  }
+  mFile = mf;
+  return parse_internal();
+}
+
+result SoundBank::loadFile(File* aFile) {
+  if (!aFile) {
+    return INVALID_PARAMETER;
+  }
+  const unsigned char* mem = aFile->getMemPtr();
+  if (mem && !((size_t)mem & 3)) {
+    return loadMem(mem, aFile->length(), false, false);
+  }
+  close();
+  MemoryFile* mf = new MemoryFile;
+  aFile->seek(0);
+  result res = mf->openFileToMem(aFile);
+  if (res != SO_NO_ERROR) {
+    delete mf;
+    return res;
+  }
+  mFile = mf;
+  return parse_internal();
+}
+
+result SoundBank::parse_internal() {
+  mData = mFile->getMemPtr();
+  mLength = mFile->length();
+  const SoundBankHeader* h = (const SoundBankHeader*)mData;
+  unsigned long long len = mLength;
+  if (!mData || len < sizeof(SoundBankHeader) ||
+      h->mMagic != SOLOUD_SOUNDBANK_MAGIC ||
+      h->mVersion != SOLOUD_SOUNDBANK_VERSION || h->mBucketCount == 0 ||
+      (h->mBucketCount & (h->mBucketCount - 1)) ||
+      ((h->mBucketOffset | h->mEntryOffset) & 3) ||
+      h->mBucketOffset + (unsigned long long)h->mBucketCount * 4 > len ||
+      h->mEntryOffset + (unsigned long long)h->mEntryCount *
+                          sizeof(SoundBankEntry) >
+        len ||
+      h->mNameLength == 0 ||
+      h->mNameOffset + (unsigned long long)h->mNameLength > len ||
+      mData[h->mNameOffset + h->mNameLength - 1] != 0) {
+    close();
+    return FILE_LOAD_FAILED;
+  }
+  mHeader = h;
+  mBuckets = (const unsigned int*)(mData + h->mBucketOffset);
+  mEntries = (const SoundBankEntry*)(mData + h->mEntryOffset);
+  mNames = (const char*)(mData + h->mNameOffset);
+  return SO_NO_ERROR;
+}
+
+unsigned int SoundBank::hash(const char* aName) {
+  unsigned int h = 2166136261u;
+  while (*aName) {
+    h ^= (unsigned char)*aName++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+int SoundBank::find(const char* aName) {
+  if (!mHeader || !aName) {
+    return -1;
+  }
+  unsigned int h = hash(aName);
+  unsigned int mask = mHeader->mBucketCount - 1;
+  unsigned int b = h & mask;
+  for (unsigned int i = 0; i <= mask; i++) {
+    unsigned int e = mBuckets[b];
+    if (e == 0 || e > mHeader->mEntryCount) {
+      return -1;
+    }
+    const SoundBankEntry& entry = mEntries[e - 1];
+    if (entry.mHash == h && entry.mNameOffset < mHeader->mNameLength &&
+        strcmp(mNames + entry.mNameOffset, aName) == 0) {
+      return (int)(e - 1);
+    }
+    b = (b + 1) & mask;
+  }
+  return -1;
+}
+
+unsigned int SoundBank::getEntryCount() {
+  return mHeader ? mHeader->mEntryCount : 0;
+}
+
+const char* SoundBank::getEntryName(unsigned int aIndex) {
+  if (aIndex >= getEntryCount() ||
+      mEntries[aIndex].mNameOffset >= mHeader->mNameLength) {
+    return 0;
+  }
+  return mNames + mEntries[aIndex].mNameOffset;
+}
+
+const unsigned char* SoundBank::getEntryData(unsigned int aIndex) {
+  if (aIndex >= getEntryCount()) {
+    return 0;
+  }
+  const SoundBankEntry& entry = mEntries[aIndex];
+  if (entry.mDataLength == 0 ||
+      entry.mDataOffset + (unsigned long long)entry.mDataLength > mLength) {
+    return 0;
+  }
+  return mData + entry.mDataOffset;
+}
+
+unsigned int SoundBank::getEntryLength(unsigned int aIndex) {
+  if (!getEntryData(aIndex)) {
+    return 0;
+  }
+  return mEntries[aIndex].mDataLength;
+}
+
+unsigned int SoundBank::getEntryType(unsigned int aIndex) {
+  if (aIndex >= getEntryCount()) {
+    return 0;
+  }
+  return mEntries[aIndex].mType;
+}
+
+SoundBankWriter::SoundBankWriter() {
+  mItems = 0;
+  mCount = 0;
+  mCapacity = 0;
+}
+
+SoundBankWriter::~SoundBankWriter() {
+  clear();
+}
+
+void SoundBankWriter::clear() {
+  for (unsigned int i = 0; i < mCount; i++) {
+    delete[] mItems[i].mName;
+    if (mItems[i].mOwned) {
+      delete[] mItems[i].mData;
+    }
+  }
+  delete[] mItems;
+  mItems = 0;
+  mCount = 0;
+  mCapacity = 0;
+}
+
+unsigned int SoundBankWriter::getEntryCount() {
+  return mCount;
+}
+
+result SoundBankWriter::addEntry(const char* aName, const unsigned char* aData,
+  unsigned int aLength, unsigned int aType, bool aCopy) {
+  if (!aName || !aData || aLength == 0) {
+    return INVALID_PARAMETER;
+  }
+  if (mCount == mCapacity) {
+    unsigned int capacity = mCapacity ? mCapacity * 2 : 64;
+    Item* items = new Item[capacity];
+    if (mCount) {
+      memcpy(items, mItems, sizeof(Item) * mCount);
+    }
+    delete[] mItems;
+    mItems = items;
+    mCapacity = capacity;
+  }
+  Item& item = mItems[mCount];
+  unsigned int namelen = (unsigned int)strlen(aName);
+  item.mName = new char[namelen + 1];
+  memcpy(item.mName, aName, namelen + 1);
+  if (aCopy) {
+    unsigned char* data = new unsigned char[aLength];
+    memcpy(data, aData, aLength);
+    aData = data;
+  }
+  item.mData = aData;
+  item.mLength = aLength;
+  item.mType = aType;
+  item.mOwned = aCopy;
+  mCount++;
+  return SO_NO_ERROR;
+}
+
+result SoundBankWriter::addFile(const char* aName, const char* aFilename) {
+  DiskFile df;
+  result res = df.open(aFilename);
+  if (res != SO_NO_ERROR) {
+    return res;
+  }
+  unsigned int len = df.length();
+  if (len == 0) {
+    return FILE_LOAD_FAILED;
+  }
+  unsigned char* data = new unsigned char[len];
+  if (df.read(data, len) != len) {
+    delete[] data;
+    return FILE_LOAD_FAILED;
+  }
+  res = addEntry(aName, data, len, SoundBank::ENCODED, false);
+  if (res != SO_NO_ERROR) {
+    delete[] data;
+    return res;
+  }
+  mItems[mCount - 1].mOwned = true;
+  return SO_NO_ERROR;
+}
+
+static unsigned long long alignUp(unsigned long long aOffset) {
+  return (aOffset + SOLOUD_SOUNDBANK_ALIGN - 1) &
+         ~(unsigned long long)(SOLOUD_SOUNDBANK_ALIGN - 1);
+}
+
+result SoundBankWriter::save(const char* aFilename) {
+  if (!aFilename) {
+    return INVALID_PARAMETER;
+  }
+  // Keep the table at most half full so probes stay short
+  unsigned int buckets = 16;
+  while (buckets < mCount * 2) {
+    buckets *= 2;
+  }
+
+  SoundBankHeader header;
+  header.mMagic = SOLOUD_SOUNDBANK_MAGIC;
+  header.mVersion = SOLOUD_SOUNDBANK_VERSION;
+  header.mEntryCount = mCount;
+  header.mBucketCount = buckets;
+  header.mBucketOffset = sizeof(SoundBankHeader);
+  header.mEntryOffset = header.mBucketOffset + buckets * 4;
+  header.mNameOffset =
+    header.mEntryOffset + mCount * (unsigned int)sizeof(SoundBankEntry);
+
+  unsigned int* table = new unsigned int[buckets];
+  memset(table, 0, buckets * sizeof(unsigned int));
+  SoundBankEntry* entries = new SoundBankEntry[mCount ? mCount : 1];
+  memset(entries, 0, sizeof(SoundBankEntry) * (mCount ? mCount : 1));
+
+  unsigned long long names = 0;
+  for (unsigned int i = 0; i < mCount; i++) {
+    entries[i].mHash = SoundBank::hash(mItems[i].mName);
+    entries[i].mNameOffset = (unsigned int)names;
+    entries[i].mDataLength = mItems[i].mLength;
+    entries[i].mType = mItems[i].mType;
+    names += strlen(mItems[i].mName) + 1;
+  }
+  // Never empty, so readers can check the block's terminator
+  if (names == 0) {
+    names = 1;
+  }
+  header.mNameLength = (unsigned int)names;
+
+  unsigned long long offset = alignUp(header.mNameOffset + names);
+  for (unsigned int i = 0; i < mCount; i++) {
+    entries[i].mDataOffset = (unsigned int)offset;
+    offset = alignUp(offset + mItems[i].mLength);
+  }
+
+  result res = SO_NO_ERROR;
+  if (offset > 0xffffffffULL) {
+    res = INVALID_PARAMETER;
+  }
+
+  for (unsigned int i = 0; i < mCount && res == SO_NO_ERROR; i++) {
+    unsigned int b = entries[i].mHash & (buckets - 1);
+    while (table[b]) {
+      unsigned int other = table[b] - 1;
+      if (entries[other].mHash == entries[i].mHash &&
+          strcmp(mItems[other].mName, mItems[i].mName) == 0) {
+        res = INVALID_PARAMETER;
+        break;
+      }
+      b = (b + 1) & (buckets - 1);
+    }
+    table[b] = i + 1;
+  }
+
+  FILE* f = 0;
+  if (res == SO_NO_ERROR) {
+    f = fopen(aFilename, "wb");
+    if (!f) {
+      res = FILE_NOT_FOUND;
+    }
+  }
+  if (res == SO_NO_ERROR) {
+    static const unsigned char zero[SOLOUD_SOUNDBANK_ALIGN] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(table, sizeof(unsigned int), buckets, f) == buckets;
+    ok = ok && (mCount == 0 || fwrite(entries, sizeof(SoundBankEntry),
+                                 mCount, f) == mCount);
+    if (mCount == 0) {
+      ok = ok && fwrite(zero, 1, 1, f) == 1;
+    }
+    for (unsigned int i = 0; i < mCount && ok; i++) {
+      size_t len = strlen(mItems[i].mName) + 1;
+      ok = fwrite(mItems[i].mName, 1, len, f) == len;
+    }
+    unsigned long long pos = header.mNameOffset + names;
+    for (unsigned int i = 0; i < mCount && ok; i++) {
+      size_t pad = (size_t)(entries[i].mDataOffset - pos);
+      ok = pad == 0 || fwrite(zero, 1, pad, f) == pad;
+      ok = ok && fwrite(mItems[i].mData, 1, mItems[i].mLength, f) ==
+                   mItems[i].mLength;
+      pos = entries[i].mDataOffset + (unsigned long long)mItems[i].mLength;
+    }
+    if (fclose(f) != 0 || !ok) {
+      res = UNKNOWN_ERROR;
+    }
+  }
+
+  delete[] table;
+  delete[] entries;
+  return res;
+}
+}  // namespace SoLoud
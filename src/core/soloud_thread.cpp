@@ -32,6 +32,7 @@ freely, subject to the following restrictions:
 #endif
 
 #include "soloud.h"
+#include "soloud_rtcheck.h"
 #include "soloud_thread.h"
 
 namespace SoLoud {
@@ -56,6 +57,12 @@ void destroyMutex(void* aHandle) {
 void lockMutex(void* aHandle) {
   CRITICAL_SECTION* cs = (CRITICAL_SECTION*)aHandle;
   if (cs) {
+#ifdef SOLOUD_RT_CHECK
+    if (TryEnterCriticalSection(cs)) {
+      return;
+    }
+    SOLOUD_RT_CHECK_CALL(MUTEX_WAIT);
+#endif
     EnterCriticalSection(cs);
   }
 }
@@ -93,6 +100,7 @@ ThreadHandle createThread(threadFunction aThreadFunction, void* aParameter) {
 }
 
 void sleep(int aMSec) {
+  SOLOUD_RT_CHECK_CALL(SLEEP);
   Sleep(aMSec);
 }
 
@@ -138,6 +146,12 @@ void destroyMutex(void* aHandle) {
 void lockMutex(void* aHandle) {
   pthread_mutex_t* mutex = (pthread_mutex_t*)aHandle;
   if (mutex) {
+#ifdef SOLOUD_RT_CHECK
+    if (pthread_mutex_trylock(mutex) == 0) {
+      return;
+    }
+    SOLOUD_RT_CHECK_CALL(MUTEX_WAIT);
+#endif
     pthread_mutex_lock(mutex);
   }
 }
@@ -172,6 +186,7 @@ ThreadHandle createThread(threadFunction aThreadFunction, void* aParameter) {
 }
 
 void sleep(int aMSec) {
+  SOLOUD_RT_CHECK_CALL(SLEEP);
   // usleep(aMSec * 1000);
   struct timespec req = {0};
   req.tv_sec = 0;
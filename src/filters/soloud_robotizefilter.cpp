@@ -51,6 +51,10 @@ void RobotizeFilterInstance::filterChannel(float* aBuffer,
   }
 }
 
+bool RobotizeFilterInstance::hasTail() {
+  return false;
+}
+
 RobotizeFilter::RobotizeFilter() {
   mFreq = 30;
   mWave = 0;
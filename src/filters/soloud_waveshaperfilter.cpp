@@ -57,6 +57,10 @@ void WaveShaperFilterInstance::filterChannel(float* aBuffer,
   }
 }
 
+bool WaveShaperFilterInstance::hasTail() {
+  return false;
+}
+
 WaveShaperFilterInstance::~WaveShaperFilterInstance() {
 }
 
@@ -0,0 +1,127 @@
+/*
+SoLoud audio engine
+Copyright (c) 2013-2015 Jari Komppa
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+   1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+
+   3. This notice may not be removed or altered from any source
+   distribution.
+*/
+
+
+// Offline sound bank packer.
+//
+//   soundbank [-pcm] [-strip prefix] out.bank file...
+//
+// Entries are named after their paths, minus a leading prefix if given.
+// -pcm decodes every file and stores it as 32-bit float wav, trading disk
+// space for load time.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "soloud.h"
+#include "soloud_soundbank.h"
+#include "soloud_wav.h"
+
+static void put32(unsigned char* aDst, unsigned int aValue) {
+  memcpy(aDst, &aValue, 4);
+}
+
+static void put16(unsigned char* aDst, unsigned int aValue) {
+  unsigned short v = (unsigned short)aValue;
+  memcpy(aDst, &v, 2);
+}
+
+// Decode aFilename and add it as an interleaved float wav
+static SoLoud::result addPcm(
+  SoLoud::SoundBankWriter& aWriter, const char* aName, const char* aFilename) {
+  SoLoud::Wav wav;
+  SoLoud::result res = wav.load(aFilename);
+  if (res != SoLoud::SO_NO_ERROR) {
+    return res;
+  }
+  unsigned int channels = wav.mChannels;
+  unsigned int samples = wav.mSampleCount;
+  unsigned int bytes = samples * channels * 4;
+  unsigned int rate = (unsigned int)wav.mBaseSamplerate;
+  unsigned char* data = new unsigned char[44 + bytes];
+  memcpy(data, "RIFF", 4);
+  put32(data + 4, 36 + bytes);
+  memcpy(data + 8, "WAVEfmt ", 8);
+  put32(data + 16, 16);
+  put16(data + 20, 3);  // IEEE float
+  put16(data + 22, channels);
+  put32(data + 24, rate);
+  put32(data + 28, rate * channels * 4);
+  put16(data + 32, channels * 4);
+  put16(data + 34, 32);
+  memcpy(data + 36, "data", 4);
+  put32(data + 40, bytes);
+  float* dst = (float*)(data + 44);
+  for (unsigned int i = 0; i < samples; i++) {
+    for (unsigned int j = 0; j < channels; j++) {
+      dst[i * channels + j] = wav.mData[j * samples + i];
+    }
+  }
+  res = aWriter.addEntry(aName, data, 44 + bytes, SoLoud::SoundBank::PCM);
+  delete[] data;
+  return res;
+}
+
+int main(int argc, char** argv) {
+  bool pcm = false;
+  const char* strip = "";
+  int arg = 1;
+  while (arg < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-pcm") == 0) {
+      pcm = true;
+    } else if (strcmp(argv[arg], "-strip") == 0 && arg + 1 < argc) {
+      strip = argv[++arg];
+    } else {
+      break;
+    }
+    arg++;
+  }
+  if (argc - arg < 2) {
+    printf("Usage: %s [-pcm] [-strip prefix] out.bank file...\n", argv[0]);
+    return 1;
+  }
+  const char* out = argv[arg++];
+  size_t striplen = strlen(strip);
+
+  SoLoud::SoundBankWriter writer;
+  for (; arg < argc; arg++) {
+    const char* name = argv[arg];
+    if (strncmp(name, strip, striplen) == 0) {
+      name += striplen;
+    }
+    SoLoud::result res = pcm ? addPcm(writer, name, argv[arg])
+                             : writer.addFile(name, argv[arg]);
+    if (res != SoLoud::SO_NO_ERROR) {
+      printf("Can't add %s (error %d)\n", argv[arg], res);
+      return 1;
+    }
+  }
+  SoLoud::result res = writer.save(out);
+  if (res != SoLoud::SO_NO_ERROR) {
+    printf("Can't write %s (error %d)\n", out, res);
+    return 1;
+  }
+  printf("%s: %u entries\n", out, writer.getEntryCount());
+  return 0;
+}